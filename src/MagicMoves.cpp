@@ -8,6 +8,11 @@
  *The magic keys are not optimal for all squares but they are very close
  *to optimal.
  *
+ *Altered for this engine: the move databases are filled in by
+ *initmagicmoves() only when building the table generator
+ *(MAGICMOVES_GENERATOR), which writes them out as constant arrays that are
+ *compiled into the engine.
+ *
  *Copyright (C) 2007 Pradyumna Kannan.
  *
  *This code is provided 'as-is', without any express or implied warranty.
@@ -155,7 +160,12 @@ const U64 magicmoves_b_mask[64]=
 };
 
 #ifdef MINIMIZE_MAGIC
+#ifdef MAGICMOVES_GENERATOR
 U64 magicmovesbdb[5248];
+#else
+//generated into tables.cpp at build time by tools/gentables.cpp
+extern const U64 magicmovesbdb[5248];
+#endif
 const U64* magicmoves_b_indices[64]=
 {
 	magicmovesbdb+4992, magicmovesbdb+2624,  magicmovesbdb+256,  magicmovesbdb+896,
@@ -185,7 +195,12 @@ const U64* magicmoves_b_indices[64]=
 #endif
 
 #ifdef MINIMIZE_MAGIC
+#ifdef MAGICMOVES_GENERATOR
 U64 magicmovesrdb[102400];
+#else
+//generated into tables.cpp at build time by tools/gentables.cpp
+extern const U64 magicmovesrdb[102400];
+#endif
 const U64* magicmoves_r_indices[64]=
 {
 	magicmovesrdb+86016, magicmovesrdb+73728, magicmovesrdb+36864, magicmovesrdb+43008,
@@ -214,6 +229,9 @@ const U64* magicmoves_r_indices[64]=
 	#endif
 #endif
 
+//the databases are only built at run time by the table generator
+#ifdef MAGICMOVES_GENERATOR
+
 U64 initmagicmoves_occ(const int* squares, const int numSquares, const U64 linocc)
 {
 	int i;
@@ -466,3 +484,5 @@ void initMagics()
 {
     initmagicmoves();
 }
+
+#endif //MAGICMOVES_GENERATOR
@@ -6,6 +6,8 @@
  *
  *Usage:
  *You must first initialize the generator with a call to initmagicmoves().
+ *(Altered for this engine: the databases are generated at build time by
+ *tools/gentables.cpp, so the engine itself never calls initmagicmoves().)
  *Then you can use the following macros for generating move bitboards by
  *giving them a square and an occupancy.  The macro will then "return"
  *the correct move bitboard for that particular square and occupancy. It
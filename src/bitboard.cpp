@@ -1,5 +1,6 @@
 #include "bitboard.hpp"
 #include <iostream>
+#include <cstdlib>
 using namespace std;
 
 extern const Bitboard AFile = 0x0101010101010101;
@@ -51,115 +52,33 @@ const int PieceVals[6] = {
 
 const Bitboard debruijn64 = 0x03f79d71b4cb0a89ULL;
 
-Bitboard pawnAttacks[2][64];
-Bitboard knightAttacks[64];
-Bitboard kingAttacks[64];
-Bitboard betweenBB[64][64];
-Bitboard lineBB[64][64];
-Bitboard pawnFrontSpan[2][64];
+bool hasPopcnt = false;
 
 
-// Initialize key bitboard constants
+// Checks that the CPU supports the instructions the build uses, and fills
+// the PEXT tables in builds that use them. The other attack tables are
+// constant data generated at build time.
 void initBitboards() {
-    initmagicmoves();
-    for (int i = 0; i < 64; i++) {
-        Bitboard b = sqToBB[i];
-        pawnAttacks[nWhite][i] = (b << 7) & ~HFile;
-        pawnAttacks[nWhite][i] |= (b << 9) & ~AFile;
-        pawnAttacks[nBlack][i] = (b >> 7) & ~AFile;
-        pawnAttacks[nBlack][i] |= (b >> 9) & ~HFile;
-
-        knightAttacks[i] = (b << 17) & ~AFile;
-        knightAttacks[i] |= (b << 10) & ~AFile &~BFile;
-        knightAttacks[i] |= (b >>  6) & ~AFile & ~BFile;
-        knightAttacks[i] |= (b >> 15) & ~AFile;
-        knightAttacks[i] |= (b << 15) & ~HFile;
-        knightAttacks[i] |= (b <<  6) & ~GFile & ~HFile;
-        knightAttacks[i] |= (b >> 10) & ~GFile & ~HFile;
-        knightAttacks[i] |= (b >> 17) & ~HFile;
-
-        kingAttacks[i] = (b << 1) & ~AFile;
-        kingAttacks[i] |= (b >> 1) & ~HFile;
-        kingAttacks[i] |= (kingAttacks[i] << 8) | (kingAttacks[i] >> 8);
-        kingAttacks[i] |= (b << 8) | (b >> 8);
-
-        int rank = i / 8;
-        int file = i & 7;
-        Bitboard frontSpan = 0x0101010101010101 << file;
-        if (file != 0) frontSpan |= 0x0101010101010101 << (file - 1);
-        if (file != 7) frontSpan |= 0x0101010101010101 << (file + 1);
-        pawnFrontSpan[nWhite][i] = frontSpan << (8 * (rank + 1));
-        pawnFrontSpan[nBlack][i] = frontSpan & ~(0xFFFFFFFFFFFFFFFF << (8 * rank));
-
-
-        // Initialize sliding bitboards
-        for (int j = 0; j <= i; j++) {
-            lineBB[i][j] = 0;
-            betweenBB[i][j] = 0;
-            if (i == j) {
-                continue;
-            }
-
-            if (slidingAttacksBB<nBishop>(i, 0) & sqToBB[j]) {
-                Bitboard diagonal = slidingAttacksBB<nBishop>(i, sqToBB[j]) &
-                    slidingAttacksBB<nBishop>(j, sqToBB[i]);
-                Bitboard lineDiagonal = (slidingAttacksBB<nBishop>(i, 0) &
-                    slidingAttacksBB<nBishop>(j, 0)) | sqToBB[i] | sqToBB[j];
-                betweenBB[i][j] = diagonal;
-                betweenBB[j][i] = diagonal;
-                lineBB[i][j] = lineDiagonal;
-                lineBB[j][i] = lineDiagonal;
-            } else if (slidingAttacksBB<nRook>(i, 0) & sqToBB[j]) {
-                betweenBB[i][j] = slidingAttacksBB<nRook>(i, sqToBB[j]) &
-                    slidingAttacksBB<nRook>(j, sqToBB[i]);
-                betweenBB[j][i] = betweenBB[i][j];
-                lineBB[i][j] = (slidingAttacksBB<nRook>(i, 0) &
-                    slidingAttacksBB<nRook>(j, 0)) | sqToBB[i] | sqToBB[j];
-                lineBB[j][i] = lineBB[i][j];
-            } else {
-                lineBB[i][j] = lineBB[j][i] = 0;
-                betweenBB[i][j] = betweenBB[j][i] = 0;
-            }
-        }
-    }
-}
-
-
-// Returns the least significant bit of the bitboard
-Square lsb(Bitboard b) {
-   return (Square)index64[((b ^ (b-1)) * debruijn64) >> 58];
-}
-
-
-// Returns the most significant bit of the bitboard
-Square msb(Bitboard b) {
-   b |= b >> 1; 
-   b |= b >> 2;
-   b |= b >> 4;
-   b |= b >> 8;
-   b |= b >> 16;
-   b |= b >> 32;
-   return (Square)index64[(b * debruijn64) >> 58];
-}
-
-
-// Pops and returns the least significant bit of the bitboard
-Square pop_lsb(Bitboard* b) {
-    Square b_lsb = lsb(*b);
-    *b &= *b - 1;
-    return b_lsb;
-}
-
-
-// Returns the number of set bits
-int popcount(Bitboard b) {
-    if (b == 0) {
-        return 0;
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    hasPopcnt = __builtin_cpu_supports("popcnt");
+#if defined(__POPCNT__) || defined(__BMI__) || defined(__LZCNT__)
+    if (!hasPopcnt || !__builtin_cpu_supports("bmi") ||
+            !__builtin_cpu_supports("lzcnt")) {
+        std::cerr << "This build needs POPCNT, BMI and LZCNT, which this CPU "
+            "lacks. Rebuild without ARCH=modern." << std::endl;
+        exit(1);
     }
-    int count = 0;
-    while (b) {
-        count++;
-        b &= b - 1;
+#endif
+#if defined(USE_PEXT)
+    if (!__builtin_cpu_supports("bmi2")) {
+        std::cerr << "This build needs BMI2, which this CPU lacks. Rebuild "
+            "without PEXT=yes." << std::endl;
+        exit(1);
     }
-    return count; 
+#endif
+#endif
+#if defined(USE_PEXT)
+    initPext();
+#endif
 }
@@ -2,6 +2,7 @@
 #define BITBOARD_H
 
 #include "MagicMoves.hpp"
+#include "pext.hpp"
 #include <string>
 #include <bitset>
 
@@ -25,12 +26,14 @@ extern const Bitboard Rank6;
 extern const Bitboard Rank7;
 extern const Bitboard Rank8;
 
-extern Bitboard pawnAttacks[2][64];
-extern Bitboard pawnFrontSpan[2][64];
-extern Bitboard knightAttacks[64];
-extern Bitboard kingAttacks[64];
-extern Bitboard betweenBB[64][64];
-extern Bitboard lineBB[64][64];
+// Attack tables, generated at build time into tables.cpp by
+// tools/gentables.cpp
+extern const Bitboard pawnAttacks[2][64];
+extern const Bitboard pawnFrontSpan[2][64];
+extern const Bitboard knightAttacks[64];
+extern const Bitboard kingAttacks[64];
+extern const Bitboard betweenBB[64][64];
+extern const Bitboard lineBB[64][64];
 
 // Holds mapping from square number to corresponding bitboard.
 extern const Bitboard sqToBB[64];
@@ -78,20 +81,77 @@ enum Direction {
 };
 
 
-// Initialize key bitboard constants
+// Checks that the CPU supports the instructions the build uses, and fills
+// the PEXT tables in builds that use them
 void initBitboards();
 
-// Returns the least significant bit of the bitboard
-Square lsb(Bitboard b); 
+// De Bruijn bit scan tables, used where no bit scan builtin is available
+extern const int index64[64];
+extern const Bitboard debruijn64;
+
+// Whether the CPU has the POPCNT instruction, found by initBitboards. Builds
+// for CPUs without it use the instruction only when this is set.
+extern bool hasPopcnt;
+
+// Returns the least significant bit of the bitboard. GCC and Clang compile
+// the builtin to BSF, or to TZCNT when built with BMI.
+inline Square lsb(Bitboard b) {
+#if defined(__GNUC__)
+    return (Square)__builtin_ctzll(b);
+#else
+    return (Square)index64[((b ^ (b-1)) * debruijn64) >> 58];
+#endif
+}
 
-// Returns the most significant bit of the bitboard
-Square msb(Bitboard b);
+// Returns the most significant bit of the bitboard. GCC and Clang compile
+// the builtin to BSR, or to LZCNT when built with it.
+inline Square msb(Bitboard b) {
+#if defined(__GNUC__)
+    return (Square)(63 ^ __builtin_clzll(b));
+#else
+    b |= b >> 1;
+    b |= b >> 2;
+    b |= b >> 4;
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+    return (Square)index64[(b * debruijn64) >> 58];
+#endif
+}
 
 // Pops and returns the least significant bit of the bitboard
-Square pop_lsb(Bitboard* b);
+inline Square pop_lsb(Bitboard* b) {
+    Square b_lsb = lsb(*b);
+    *b &= *b - 1;
+    return b_lsb;
+}
 
-// returns the number of set bits in the bitboard
-int popcount(Bitboard b);
+// Returns the number of set bits in the bitboard without using POPCNT
+inline int popcountSoftware(Bitboard b) {
+    b = b - ((b >> 1) & 0x5555555555555555ULL);
+    b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+    b = (b + (b >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((b * 0x0101010101010101ULL) >> 56);
+}
+
+// returns the number of set bits in the bitboard. A build with POPCNT
+// enabled uses the instruction directly, a generic x86-64 build checks
+// hasPopcnt, a branch that always goes the same way, and other builds count
+// in software.
+inline int popcount(Bitboard b) {
+#if defined(__POPCNT__)
+    return __builtin_popcountll(b);
+#elif defined(__GNUC__) && defined(__x86_64__)
+    if (hasPopcnt) {
+        Bitboard count;
+        __asm__("popcntq %1, %0" : "=r" (count) : "r" (b));
+        return (int)count;
+    }
+    return popcountSoftware(b);
+#else
+    return popcountSoftware(b);
+#endif
+}
 
 
 // Shifts the bitboard in a given direction
@@ -118,11 +178,17 @@ constexpr Bitboard pawnAttacksBB(Bitboard pawns) {
 
 
 // Returns the sliding piece attacks for given piece from a square, given
-// occupied squares
+// occupied squares. Builds with USE_PEXT index the tables with PEXT instead
+// of the magics.
 template<Piece P>
 constexpr Bitboard slidingAttacksBB(int sq, Bitboard occupied) {
+#if defined(USE_PEXT)
+    return (P == nBishop ? Bpext(sq, occupied) : (P == nRook ? Rpext(sq, occupied) :
+           (P == nQueen ? Bpext(sq, occupied) | Rpext(sq, occupied) : 0)));
+#else
     return (P == nBishop ? Bmagic(sq, occupied) : (P == nRook ? Rmagic(sq, occupied) :
            (P == nQueen ? Bmagic(sq, occupied) | Rmagic(sq, occupied) : 0)));
+#endif
 }
 
 
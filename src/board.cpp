@@ -3,56 +3,48 @@
  */
 
 #include "board.hpp"
-#include <random>
 using namespace std;
 
-// Holds zobrist random values
-namespace Zobrist {
-    unsigned long long pieces[12][64];
-    unsigned long long blackMove;
-    unsigned long long castling[4];
-    unsigned long long enPassant[8];
-};
+// Returns the packed material and piece square value of a piece on a square
+static inline Score psqValue(Piece p, Color c, int sq) {
+    if (c == nBlack) {
+        sq = 8 * (7 - sq / 8) + (sq & 7);
+    }
+    return makeScore(PieceVals[p] + pieceTable[p][sq], PieceVals[p] +
+            (p == nKing ? kingTableEndgame[sq] : pieceTable[p][sq]));
+}
 
 
-// Initializes 81 random 64-bit numbers.
-void initZobrist() {
-    random_device rd;
-    mt19937_64 eng(rd());
-    uniform_int_distribution<unsigned long long> distr;
-    for (int color = nWhite; color <= nBlack; color++) {
-        for (int piece = nPawn; piece <= nKing; piece++) {
-            for (int sq = A1; sq <= H8; sq++) {
-                Zobrist::pieces[2 * color + piece][sq] = distr(eng);
-            }
-        }
-    }
-    for (int i = 0; i < 4; i++) {
-        Zobrist::castling[i] = distr(eng);
-    }
-    for (int i = 0; i < 8; i++) {
-        Zobrist::enPassant[i] = distr(eng);
-    }
-    Zobrist::blackMove = distr(eng);
+// Adds a piece on a square to the material scores and game phase of a state,
+// or removes it when sign is -1
+static inline void updateMaterial(StateInfo* st, Piece p, Color c, int sq,
+        int sign) {
+    st->material[c] += sign * psqValue(p, c, sq);
+    st->phaseWeight += sign * phaseWeight[p];
 }
 
 
 // Initializes the zobrist hash key to the current board position
 void Board::setZobrist() {
     unsigned long long hashKey = 0;
+    unsigned long long pawnKey = 0;
     for (int color = nWhite; color <= nBlack; color++) {
         for (int piece = nPawn; piece <= nKing; piece++) {
             Bitboard pieces = getPieces((Color)color, (Piece)piece);
             while (pieces) {
                 int sq = pop_lsb(&pieces);
-                hashKey ^= Zobrist::pieces[2 * color + piece][sq];
+                hashKey ^= Zobrist::pieces[6 * color + piece][sq];
+                if (piece == nPawn) {
+                    pawnKey ^= Zobrist::pieces[6 * color + piece][sq];
+                }
             }
         }
     }
 
-    short castle = castling.top();
+    StateInfo* st = &states[statePly];
+    st->pawnKey = pawnKey;
     for (int i = 0; i < 4; i++) {
-        if (castle & (1 << i)) {
+        if (st->castling & (1 << i)) {
             hashKey ^= Zobrist::castling[i];
         }
     }
@@ -61,17 +53,15 @@ void Board::setZobrist() {
         hashKey ^= Zobrist::blackMove;
     }
 
-    if (enPassant.top() != SQ_NONE) {
-        hashKey ^= Zobrist::enPassant[enPassant.top() % 8];
+    if (st->enPassant != SQ_NONE) {
+        hashKey ^= Zobrist::enPassant[st->enPassant % 8];
     }
-    zobrist.push_back(hashKey);
+    st->zobrist = hashKey;
 }
 
 
 // Constructs a new Board object
 Board::Board() {
-    initZobrist();
-
     // initialize pieces
     pieceBB[0] = Rank1 | Rank2;
     pieceBB[1] = Rank7 | Rank8;
@@ -84,15 +74,18 @@ Board::Board() {
 
     occupiedBB = (pieceBB[0] | pieceBB[1]);
     emptyBB = ~occupiedBB;
+    setMailbox();
 
-    enPassant.push(SQ_NONE);
-    castling.push(0b1111);
-    capturedList.push(PIECE_NONE);
+    statePly = 0;
+    states[0].enPassant = SQ_NONE;
+    states[0].castling = 0b1111;
+    states[0].captured = PIECE_NONE;
+    states[0].fiftyMove = 0;
     toMove = nWhite;
-    fiftyList.push(0);
     fullMove = 1;
 
     setZobrist();
+    setMaterial();
 }
 
 
@@ -102,28 +95,47 @@ Board::Board() {
  * @param FEN the desired starting position in FEN form
  */
 Board::Board(std::string FEN) {
-    initZobrist();
     setPosition(FEN);
 }
 
 
+// Copies a board, leaving the states past the current ply uninitialized
+Board::Board(const Board& other) : moveList(other.moveList) {
+    copyFrom(other);
+}
+
+
+Board& Board::operator=(const Board& other) {
+    if (this != &other) {
+        moveList = other.moveList;
+        copyFrom(other);
+    }
+    return *this;
+}
+
+
+// Copies the position and the states up to the current ply of a board
+void Board::copyFrom(const Board& other) {
+    std::copy(other.pieceBB, other.pieceBB + 8, pieceBB);
+    emptyBB = other.emptyBB;
+    occupiedBB = other.occupiedBB;
+    toMove = other.toMove;
+    fullMove = other.fullMove;
+    statePly = other.statePly;
+    std::copy(other.states, other.states + statePly + 1, states);
+    std::copy(other.mailbox, other.mailbox + 64, mailbox);
+}
+
+
 /**
  * Given the current board, sets the position of the board to the given FEN.
  *
  * @param FEN the desired position the board will be sent to.
  */
 void Board::setPosition(std::string FEN) {
-    enPassant = stack<Square>();
-    castling = stack<short>();
-    fiftyList = stack<int>();
-    capturedList = stack<Piece>();
-    zobrist = vector<unsigned long long>();
-    //for (int i = 0; i < 100000; i++)
-    //    transTable[i] = HashEntry();
-    // initializes killer move list
-    //for (int i = 0; i < SEARCH_DEPTH + 1; i++)
-    //    for (int j = 0; j < 2; j++)
-    //        killerMoves[i][j] = Move();
+    statePly = 0;
+    StateInfo* st = &states[0];
+    st->captured = PIECE_NONE;
 
     pieceBB[0] = 0; 
     pieceBB[1] = 0;
@@ -209,28 +221,30 @@ void Board::setPosition(std::string FEN) {
                 break;
         }
     }
-    castling.push(castle);
+    st->castling = castle;
 
     // en passant
     if (result[3] == "-") {
-        enPassant.push(SQ_NONE);
+        st->enPassant = SQ_NONE;
     } else {
-        enPassant.push((Square)(std::find(squareNames, squareNames+65, result[3]) -
-                    squareNames));
+        st->enPassant = (Square)(std::find(squareNames, squareNames+65, result[3]) -
+                    squareNames);
     }
 
     if (result.size() == 6) {
-        fiftyList.push(stoi(result[4]));
+        st->fiftyMove = stoi(result[4]);
         fullMove = stoi(result[5]);
     } else {
-        fiftyList.push(0);
+        st->fiftyMove = 0;
         fullMove = 1;
     }
 
     occupiedBB = (pieceBB[0] | pieceBB[1]);
     emptyBB = ~occupiedBB;
+    setMailbox();
 
     setZobrist(); 
+    setMaterial();
 }
 
 
@@ -288,7 +302,7 @@ std::string Board::getFEN() const {
     FEN += (toMove == nWhite ? "w" : "b");
     FEN += " ";
 
-    short castle = castling.top();
+    short castle = states[statePly].castling;
     if (castle & 0b1000) {
         FEN += "K";
     }  
@@ -307,10 +321,11 @@ std::string Board::getFEN() const {
         FEN += "- ";
     }
 
-    FEN += (enPassant.top() == SQ_NONE ? "-" : squareNames[enPassant.top()]);
+    Square ep = states[statePly].enPassant;
+    FEN += (ep == SQ_NONE ? "-" : squareNames[ep]);
     FEN += " ";
 
-    FEN += std::to_string(fiftyList.top()) + " " + std::to_string(fullMove);
+    FEN += std::to_string(states[statePly].fiftyMove) + " " + std::to_string(fullMove);
 
     return FEN;
 }
@@ -334,36 +349,35 @@ Bitboard Board::getPieces(Color ct, Piece pt) const {
 }
 
 
-// Returns the piece on a given square
-Piece Board::getPiece(int sq) const {
-    Bitboard sqBB = sqToBB[sq];
-    if (sqBB & pieceBB[2 + nPawn]) {
-        return nPawn;
-    } else if (sqBB & pieceBB[2 + nKnight]) {
-        return nKnight;
-    } else if (sqBB & pieceBB[2 + nBishop]) {
-        return nBishop;
-    } else if (sqBB & pieceBB[2 + nRook]) {
-        return nRook;
-    } else if (sqBB & pieceBB[2 + nQueen]) {
-        return nQueen;
-    } else if (sqBB & pieceBB[2 + nKing]) {
-        return nKing;
-    } else {
-        return PIECE_NONE;
+// Fills the mailbox from the piece bitboards
+void Board::setMailbox() {
+    for (int sq = A1; sq <= H8; sq++) {
+        mailbox[sq] = EMPTY_SQUARE;
+    }
+    for (int color = nWhite; color <= nBlack; color++) {
+        for (int piece = nPawn; piece <= nKing; piece++) {
+            Bitboard pieces = getPieces((Color)color, (Piece)piece);
+            while (pieces) {
+                mailbox[pop_lsb(&pieces)] = toSquare((Piece)piece, (Color)color);
+            }
+        }
     }
 }
 
 
-// Returns the color of the piece on the given square
-Color Board::getColor(int sq) const {
-    Bitboard sqBB = sqToBB[sq];
-    if (sqBB & pieceBB[nWhite]) {
-        return nWhite;
-    } else if (sqBB & pieceBB[nBlack]) {
-        return nBlack;
-    } else {
-        return COLOR_NONE;
+// Sets the material scores of the current state from the piece bitboards
+void Board::setMaterial() {
+    StateInfo* st = &states[statePly];
+    st->phaseWeight = 0;
+    for (int color = nWhite; color <= nBlack; color++) {
+        st->material[color] = 0;
+        for (int piece = nPawn; piece <= nKing; piece++) {
+            Bitboard pieces = getPieces((Color)color, (Piece)piece);
+            while (pieces) {
+                updateMaterial(st, (Piece)piece, (Color)color,
+                        pop_lsb(&pieces), 1);
+            }
+        }
     }
 }
 
@@ -405,13 +419,13 @@ Bitboard Board::getEmpty() const {
 
 // Returns the square that is the en passant target, if it exists
 Square Board::enPassantTarget() const {
-    return enPassant.top();
+    return states[statePly].enPassant;
 }
 
 
 // Returns the castling rights of the board
 short Board::getCastlingRights() const {
-    return castling.top();
+    return states[statePly].castling;
 }
 
 
@@ -423,18 +437,31 @@ Color Board::getToMove() const {
 
 // Returns the zobrist hash key
 unsigned long long Board::getZobrist() const {
-    return zobrist.back();
+    return states[statePly].zobrist;
+}
+
+
+// Returns the zobrist key of the pawns alone
+unsigned long long Board::getPawnKey() const {
+    return states[statePly].pawnKey;
 }
 
 
 // Returns the fifty move counter
 int Board::getFiftyCount() const {
-    return fiftyList.top();
+    return states[statePly].fiftyMove;
 }
 
 
 // Returns whether a square is attacked by a given side
 bool Board::attacked(int square, Color side) const {
+    return attacked(square, side, occupiedBB);
+}
+
+
+// Returns whether a square is attacked by a given side, with sliding attacks
+// blocked only by the given occupancy
+bool Board::attacked(int square, Color side, Bitboard occupied) const {
     Bitboard pawns = getPieces(side, nPawn);
     if (pawnAttacks[side^1][square] & pawns) {
         return true;
@@ -448,11 +475,11 @@ bool Board::attacked(int square, Color side) const {
         return true;
     }
     Bitboard bishopsQueens = getPieces(side, nQueen) | getPieces(side, nBishop);
-    if (slidingAttacksBB<nBishop>(square, occupiedBB) & bishopsQueens) {
+    if (slidingAttacksBB<nBishop>(square, occupied) & bishopsQueens) {
         return true;
     }
     Bitboard rooksQueens = getPieces(side, nQueen) | getPieces(side, nRook);
-    if (slidingAttacksBB<nRook>(square, occupiedBB) & rooksQueens) {
+    if (slidingAttacksBB<nRook>(square, occupied) & rooksQueens) {
         return true;
     }
     return false;
@@ -482,6 +509,20 @@ Bitboard Board::getAttackers(Square sq, Color c) const {
 }
 
 
+// Returns a bitboard holding the pieces of both colors attacking the square,
+// with sliding attacks blocked only by the given occupancy
+Bitboard Board::attackersTo(Square sq, Bitboard occupied) const {
+    Bitboard bishopsQueens = getPieces(nBishop) | getPieces(nQueen);
+    Bitboard rooksQueens = getPieces(nRook) | getPieces(nQueen);
+    return (pawnAttacks[nBlack][sq] & getPieces(nWhite, nPawn))
+        | (pawnAttacks[nWhite][sq] & getPieces(nBlack, nPawn))
+        | (knightAttacks[sq] & getPieces(nKnight))
+        | (kingAttacks[sq] & getPieces(nKing))
+        | (slidingAttacksBB<nBishop>(sq, occupied) & bishopsQueens)
+        | (slidingAttacksBB<nRook>(sq, occupied) & rooksQueens);
+}
+
+
 // Returns a color's least valuable attacker of a square
 Square Board::lva(Square sq, Color side) const {
     Bitboard pawns = getPieces(side, nPawn);
@@ -506,7 +547,7 @@ Square Board::lva(Square sq, Color side) const {
         return lsb(rookAttackers);
     }
 
-    Bitboard queens = getPieces(side, nRook);
+    Bitboard queens = getPieces(side, nQueen);
     Bitboard queenAttackers = (slidingAttacksBB<nBishop>(sq, occupiedBB) |
             slidingAttacksBB<nRook>(sq, occupiedBB)) & queens;
     if (queenAttackers) {
@@ -521,42 +562,142 @@ Square Board::lva(Square sq, Color side) const {
 }
 
 
-// Returns whether a board is in check or not
-bool Board::inCheck() const {
-    Square kingSquare = lsb(getPieces(toMove, nKing)); 
-    Color other = (toMove == nWhite ? nBlack : nWhite);
-    return(attacked(kingSquare, other));
-}
+// Returns the material the side to move wins with a capture once every
+// recapture on the square has been played out. Each side recaptures with its
+// least valuable attacker, and removing it from the occupancy uncovers any
+// slider behind it. Either side may stop capturing when that is better.
+int Board::see(Move m) const {
+    int gain[32];
+    int d = 0;
+    Square to = (Square)m.getTo();
+    Bitboard fromBB = sqToBB[m.getFrom()];
+    Bitboard occupied = occupiedBB;
+    Bitboard attackers = attackersTo(to, occupied);
+    Bitboard bishopsQueens = getPieces(nBishop) | getPieces(nQueen);
+    Bitboard rooksQueens = getPieces(nRook) | getPieces(nQueen);
+    Color side = toMove;
+    Piece piece = getPiece(m.getFrom());
 
+    if (m.getFlags() == 5) { // en passant
+        gain[0] = PieceVals[nPawn];
+        occupied ^= sqToBB[to + (toMove == nWhite ? -8 : 8)];
+    } else {
+        gain[0] = (m.isCapture() ? PieceVals[getPiece(to)] : 0);
+    }
+    if (m.isPromotion()) {
+        piece = (Piece)(1 + (m.getFlags() & 3));
+        gain[0] += PieceVals[piece] - PieceVals[nPawn];
+    }
 
-// Returns whether a board is in double check or not
-bool Board::doubleCheck() const {
-    int kingSquare = lsb(getPieces(toMove, nKing)); 
-    Color other = (toMove == nWhite ? nBlack : nWhite);
-    int count = 0;
+    while (true) {
+        d++;
+        // value of the piece on the square if the other side takes it
+        gain[d] = PieceVals[piece] - gain[d - 1];
+        if (d == 31) {
+            break;
+        }
+        occupied ^= fromBB;
+        attackers |= (slidingAttacksBB<nBishop>(to, occupied) & bishopsQueens)
+            | (slidingAttacksBB<nRook>(to, occupied) & rooksQueens);
+        attackers &= occupied;
+        side = (side == nWhite ? nBlack : nWhite);
+
+        Bitboard sideAttackers = attackers & getPieces(side);
+        if (!sideAttackers) {
+            break;
+        }
+        for (int p = nPawn; p <= nKing; p++) {
+            if (sideAttackers & getPieces((Piece)p)) {
+                piece = (Piece)p;
+                fromBB = sqToBB[lsb(sideAttackers & getPieces((Piece)p))];
+                break;
+            }
+        }
+        // the king can only take if the other side has nothing left
+        if (piece == nKing && (attackers & ~getPieces(side))) {
+            break;
+        }
+    }
 
-    Bitboard knights = getPieces(other, nKnight);
-    if (knightAttacks[kingSquare] & knights) {
-        count++;
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
     }
-    Bitboard bishopsQueens = getPieces(other, nQueen) | getPieces(other,
-            nBishop);
-    if (slidingAttacksBB<nBishop>(kingSquare, occupiedBB) & bishopsQueens) {
-        if (count == 1) {
-            return true;
-        }
-        count++;
+    return gain[0];
+}
+
+
+// Returns whether the static exchange value of a move is at least the
+// threshold. Instead of building the whole swap list, it tracks only the
+// balance relative to the threshold and stops as soon as the side to
+// recapture cannot change the outcome.
+bool Board::seeGe(Move m, int threshold) const {
+    int flags = m.getFlags();
+    if (flags == 2 || flags == 3 || flags == 5 || m.isPromotion()) {
+        return see(m) >= threshold;
     }
 
-    if (count == 0) {
+    Square from = (Square)m.getFrom();
+    Square to = (Square)m.getTo();
+    int swap = (m.isCapture() ? PieceVals[getPiece(to)] : 0) - threshold;
+    if (swap < 0) {
         return false;
     }
-
-    Bitboard rooksQueens = getPieces(other, nQueen) | getPieces(other, nRook);
-    if (slidingAttacksBB<nRook>(kingSquare, occupiedBB) & rooksQueens) {
+    swap = PieceVals[getPiece(from)] - swap;
+    if (swap <= 0) {
         return true;
     }
-    return false;
+
+    Bitboard occupied = occupiedBB ^ sqToBB[from] ^ sqToBB[to];
+    Bitboard attackers = attackersTo(to, occupied);
+    Bitboard bishopsQueens = getPieces(nBishop) | getPieces(nQueen);
+    Bitboard rooksQueens = getPieces(nRook) | getPieces(nQueen);
+    Color side = getColor(from);
+    int result = 1;
+
+    while (true) {
+        side = (side == nWhite ? nBlack : nWhite);
+        attackers &= occupied;
+        Bitboard sideAttackers = attackers & getPieces(side);
+        if (!sideAttackers) {
+            break;
+        }
+        result ^= 1;
+
+        Piece p = nPawn;
+        while (!(sideAttackers & getPieces(p))) {
+            p = (Piece)(p + 1);
+        }
+        if (p == nKing) {
+            // the king can only take if the other side has nothing left
+            return (attackers & ~getPieces(side)) ? result ^ 1 : result;
+        }
+        swap = PieceVals[p] - swap;
+        if (swap < result) {
+            break;
+        }
+        occupied ^= sqToBB[lsb(sideAttackers & getPieces(p))];
+        if (p == nPawn || p == nBishop || p == nQueen) {
+            attackers |= slidingAttacksBB<nBishop>(to, occupied) & bishopsQueens;
+        }
+        if (p == nRook || p == nQueen) {
+            attackers |= slidingAttacksBB<nRook>(to, occupied) & rooksQueens;
+        }
+    }
+    return result;
+}
+
+
+// Returns whether a board is in check or not
+bool Board::inCheck() const {
+    Square kingSquare = lsb(getPieces(toMove, nKing)); 
+    Color other = (toMove == nWhite ? nBlack : nWhite);
+    return(attacked(kingSquare, other));
+}
+
+
+// Returns whether a board is in double check or not
+bool Board::doubleCheck() const {
+    return popcount(getCheckers()) > 1;
 }
 
 
@@ -602,9 +743,13 @@ Bitboard Board::pinnedPieces(Bitboard pinners, Square sq) const {
 
 // Makes a legal move on the chessboard
 void Board::makeMove(Move m) {
-    unsigned long long hashKey = zobrist.back();
+    assert(statePly + 1 < MAX_GAME_PLY);
+    const StateInfo* prev = &states[statePly];
+    StateInfo* st = &states[++statePly];
+    unsigned long long hashKey = prev->zobrist;
+    unsigned long long pawnKey = prev->pawnKey;
     // increments move counters
-    int fiftyCounter = fiftyList.top() + 1;
+    int fiftyCounter = prev->fiftyMove + 1;
     if (toMove == nBlack) { 
         fullMove++;
     }
@@ -632,26 +777,36 @@ void Board::makeMove(Move m) {
     pieceBB[(int)startP + 2] ^= startEndBB; 
     pieceBB[(int)startC] ^= startEndBB;
 
-    hashKey ^= Zobrist::pieces[2 * startC + startP][start];
-    hashKey ^= Zobrist::pieces[2 * startC + startP][end];
+    hashKey ^= Zobrist::pieces[6 * startC + startP][start];
+    hashKey ^= Zobrist::pieces[6 * startC + startP][end];
+
+    st->material[nWhite] = prev->material[nWhite];
+    st->material[nBlack] = prev->material[nBlack];
+    st->phaseWeight = prev->phaseWeight;
+    updateMaterial(st, startP, startC, start, -1);
+    updateMaterial(st, startP, startC, end, 1);
+    if (startP == nPawn) {
+        pawnKey ^= Zobrist::pieces[6 * startC + nPawn][start];
+        pawnKey ^= Zobrist::pieces[6 * startC + nPawn][end];
+    }
 
-    short newCastling = castling.top();
+    short newCastling = prev->castling;
 
     // Resets fifty move counter if pawn move or capture
     if (startP == nPawn || capture) {
         fiftyCounter = 0;
     }
 
-    if (enPassant.top() != SQ_NONE) {
-        hashKey ^= Zobrist::enPassant[enPassant.top() % 8];
+    if (prev->enPassant != SQ_NONE) {
+        hashKey ^= Zobrist::enPassant[prev->enPassant % 8];
     }
 
     // Double pawn move
     if (flags == 1) {
-        enPassant.push((Square)(startC == nWhite ? end - 8 : end + 8));
-        hashKey ^= Zobrist::enPassant[enPassant.top() % 8];
+        st->enPassant = (Square)(startC == nWhite ? end - 8 : end + 8);
+        hashKey ^= Zobrist::enPassant[st->enPassant % 8];
     } else {
-        enPassant.push(SQ_NONE);
+        st->enPassant = SQ_NONE;
     }
 
     if (flags == 5) { // en passant
@@ -659,52 +814,63 @@ void Board::makeMove(Move m) {
         if (startC == nWhite) {
             pieceBB[2] ^= sqToBB[end - 8];    
             pieceBB[1] ^= sqToBB[end - 8];
-            hashKey ^= Zobrist::pieces[2 * nBlack + nPawn][end - 8];
+            hashKey ^= Zobrist::pieces[6 * nBlack + nPawn][end - 8];
+            updateMaterial(st, nPawn, nBlack, end - 8, -1);
+            pawnKey ^= Zobrist::pieces[6 * nBlack + nPawn][end - 8];
         } else {
             pieceBB[2] ^= sqToBB[end + 8];    
             pieceBB[0] ^= sqToBB[end + 8];
-            hashKey ^= Zobrist::pieces[2 * nWhite + nPawn][end + 8];
+            hashKey ^= Zobrist::pieces[6 * nWhite + nPawn][end + 8];
+            updateMaterial(st, nPawn, nWhite, end + 8, -1);
+            pawnKey ^= Zobrist::pieces[6 * nWhite + nPawn][end + 8];
         }
     } else if (capture) {
         pieceBB[(int) endP + 2] ^= endBB;
         pieceBB[(int) endC] ^= endBB;
-        hashKey ^= Zobrist::pieces[2 * endC + endP][end];
+        hashKey ^= Zobrist::pieces[6 * endC + endP][end];
+        updateMaterial(st, endP, endC, end, -1);
+        if (endP == nPawn) {
+            pawnKey ^= Zobrist::pieces[6 * endC + nPawn][end];
+        }
     }
 
     if (prom) {
         int promPiece = 1 + (flags & 3);
         pieceBB[promPiece + 2] ^= endBB;
         pieceBB[2] ^= endBB;
-        hashKey ^= Zobrist::pieces[2 * startC + promPiece][end];
-        hashKey ^= Zobrist::pieces[2 * startC + nPawn][end];
+        hashKey ^= Zobrist::pieces[6 * startC + promPiece][end];
+        hashKey ^= Zobrist::pieces[6 * startC + nPawn][end];
+        updateMaterial(st, (Piece)promPiece, startC, end, 1);
+        updateMaterial(st, nPawn, startC, end, -1);
+        pawnKey ^= Zobrist::pieces[6 * startC + nPawn][end];
     } 
 
     if (flags == 2) { // castling
         if (startC == nWhite) {
             pieceBB[nRook + 2] ^= (sqToBB[F1] | sqToBB[H1]);
             pieceBB[startC] ^= (sqToBB[F1] | sqToBB[H1]);
-            hashKey ^= Zobrist::pieces[2 * nWhite + nRook][F1];
-            hashKey ^= Zobrist::pieces[2 * nWhite + nRook][H1];
+            hashKey ^= Zobrist::pieces[6 * nWhite + nRook][F1];
+            hashKey ^= Zobrist::pieces[6 * nWhite + nRook][H1];
             newCastling &= 0b0011;
         } else { 
             pieceBB[nRook + 2] ^= (sqToBB[F8] | sqToBB[H8]);
             pieceBB[startC] ^= (sqToBB[F8] | sqToBB[H8]);
-            hashKey ^= Zobrist::pieces[2 * nBlack + nRook][F8];
-            hashKey ^= Zobrist::pieces[2 * nBlack + nRook][H8];
+            hashKey ^= Zobrist::pieces[6 * nBlack + nRook][F8];
+            hashKey ^= Zobrist::pieces[6 * nBlack + nRook][H8];
             newCastling &= 0b1100;
         }
     } else if (flags == 3)  { // queenside
         if (startC == nWhite) {
             pieceBB[nRook + 2] ^= (sqToBB[A1] | sqToBB[D1]);
             pieceBB[startC] ^= (sqToBB[A1] | sqToBB[D1]);
-            hashKey ^= Zobrist::pieces[2 * nWhite + nRook][A1];
-            hashKey ^= Zobrist::pieces[2 * nWhite + nRook][D1];
+            hashKey ^= Zobrist::pieces[6 * nWhite + nRook][A1];
+            hashKey ^= Zobrist::pieces[6 * nWhite + nRook][D1];
             newCastling &= 0b0011;
         } else { 
             pieceBB[nRook + 2] ^= (sqToBB[A8] | sqToBB[D8]);
             pieceBB[startC] ^= (sqToBB[A8] | sqToBB[D8]);
-            hashKey ^= Zobrist::pieces[2 * nBlack + nRook][A8];
-            hashKey ^= Zobrist::pieces[2 * nBlack + nRook][D8];
+            hashKey ^= Zobrist::pieces[6 * nBlack + nRook][A8];
+            hashKey ^= Zobrist::pieces[6 * nBlack + nRook][D8];
             newCastling &= 0b1100;
         }
     } 
@@ -741,19 +907,39 @@ void Board::makeMove(Move m) {
         }
     }
 
+    short changedCastling = newCastling ^ prev->castling;
     for (int i = 0; i < 4; i++) {
-        if (newCastling & (1 << i)) {
+        if (changedCastling & (1 << i)) {
             hashKey ^= Zobrist::castling[i];
         }
     }
 
-    castling.push(newCastling);
+    if (flags == 2 || flags == 3) { // the castling rook
+        updateMaterial(st, nRook, startC, flags == 2 ? end + 1 :
+                end - 2, -1);
+        updateMaterial(st, nRook, startC, flags == 2 ? end - 1 :
+                end + 1, 1);
+    }
+
+    // update the mailbox
+    mailbox[start] = EMPTY_SQUARE;
+    mailbox[end] = toSquare(prom ? (Piece)(1 + (flags & 3)) : startP, startC);
+    if (flags == 5) {
+        mailbox[startC == nWhite ? end - 8 : end + 8] = EMPTY_SQUARE;
+    } else if (flags == 2 || flags == 3) {
+        int rookFrom = (flags == 2 ? end + 1 : end - 2);
+        int rookTo = (flags == 2 ? end - 1 : end + 1);
+        mailbox[rookTo] = mailbox[rookFrom];
+        mailbox[rookFrom] = EMPTY_SQUARE;
+    }
 
     occupiedBB = (pieceBB[0] | pieceBB[1]);
     emptyBB = ~occupiedBB;
-    capturedList.push(endP);
-    fiftyList.push(fiftyCounter);
-    zobrist.push_back(hashKey);
+    st->castling = newCastling;
+    st->captured = endP;
+    st->fiftyMove = fiftyCounter;
+    st->zobrist = hashKey;
+    st->pawnKey = pawnKey;
 }
 
 
@@ -766,17 +952,13 @@ void Board::unmakeMove(Move m) {
 
     toMove = (toMove == nWhite ? nBlack : nWhite);
         
-    Piece endP = capturedList.top();
+    Piece endP = states[statePly].captured;
 
     bool prom = m.isPromotion();
     bool capture = m.isCapture();
 
-    // makes lists previous state
-    castling.pop();
-    enPassant.pop();
-    capturedList.pop();
-    fiftyList.pop();
-    zobrist.pop_back();
+    // returns to the previous state
+    statePly--;
     int start = m.getFrom();
     int end = m.getTo();
     int flags = m.getFlags();
@@ -830,6 +1012,18 @@ void Board::unmakeMove(Move m) {
         }
     } 
 
+    // restore the mailbox
+    mailbox[start] = toSquare(startP, startC);
+    mailbox[end] = (capture && flags != 5 ? toSquare(endP, other) : EMPTY_SQUARE);
+    if (flags == 5) {
+        mailbox[startC == nWhite ? end - 8 : end + 8] = toSquare(nPawn, other);
+    } else if (flags == 2 || flags == 3) {
+        int rookFrom = (flags == 2 ? end + 1 : end - 2);
+        int rookTo = (flags == 2 ? end - 1 : end + 1);
+        mailbox[rookFrom] = mailbox[rookTo];
+        mailbox[rookTo] = EMPTY_SQUARE;
+    }
+
     occupiedBB = (pieceBB[0] | pieceBB[1]);
     emptyBB = ~occupiedBB;
 }
@@ -837,15 +1031,24 @@ void Board::unmakeMove(Move m) {
 
 // Makes a null move (switches color) for the current position
 void Board::makeNullMove() {
-    unsigned long long hashKey = zobrist.back();
+    assert(statePly + 1 < MAX_GAME_PLY);
+    const StateInfo* prev = &states[statePly];
+    StateInfo* st = &states[++statePly];
+    unsigned long long hashKey = prev->zobrist;
     hashKey ^= Zobrist::blackMove;
     
-    if (enPassant.top() != SQ_NONE) {
-        hashKey ^= Zobrist::enPassant[enPassant.top() % 8];
+    if (prev->enPassant != SQ_NONE) {
+        hashKey ^= Zobrist::enPassant[prev->enPassant % 8];
     }
-    enPassant.push(SQ_NONE);
-    capturedList.push(PIECE_NONE);
-    zobrist.push_back(hashKey);
+    st->enPassant = SQ_NONE;
+    st->castling = prev->castling;
+    st->fiftyMove = prev->fiftyMove;
+    st->captured = PIECE_NONE;
+    st->zobrist = hashKey;
+    st->pawnKey = prev->pawnKey;
+    st->material[nWhite] = prev->material[nWhite];
+    st->material[nBlack] = prev->material[nBlack];
+    st->phaseWeight = prev->phaseWeight;
 
     toMove = (toMove == nWhite ? nBlack : nWhite);
 }
@@ -853,14 +1056,97 @@ void Board::makeNullMove() {
 
 // Unmakes a null move for the current position
 void Board::unmakeNullMove() {
-    enPassant.pop();
-    capturedList.pop();
-    zobrist.pop_back();
+    statePly--;
 
     toMove = (toMove == nWhite ? nBlack : nWhite);
 }
 
 
+// Checks if a move, possibly taken from another position such as a hash
+// entry or killer slot, could be generated in this one ignoring whether it
+// leaves the king in check
+bool Board::isPseudoLegal(Move m) const {
+    int start = m.getFrom();
+    int end = m.getTo();
+    int flags = m.getFlags();
+    Piece piece = getPiece(start);
+    Color other = (toMove == nWhite ? nBlack : nWhite);
+    int up = (toMove == nWhite ? 8 : -8);
+
+    if (start == end || getColor(start) != toMove || flags == 6 || flags == 7) {
+        return false;
+    }
+
+    if (flags == 5) { // en passant
+        return piece == nPawn && end == states[statePly].enPassant &&
+            (pawnAttacks[toMove][start] & sqToBB[end]);
+    }
+
+    // captures must take an enemy piece and other moves land on empty squares
+    if (m.isCapture() ? getColor(end) != other || getPiece(end) == nKing :
+            getColor(end) != COLOR_NONE) {
+        return false;
+    }
+
+    if (flags == 2 || flags == 3) { // castling
+        bool kingSide = (flags == 2);
+        Square kingSq = (toMove == nWhite ? E1 : E8);
+        Square rookSq = (Square)(kingSide ? kingSq + 3 : kingSq - 4);
+        if (piece != nKing || start != kingSq || end != (kingSide ? kingSq + 2
+                    : kingSq - 2) || !((states[statePly].castling >> (2 *
+                        other + kingSide)) & 1) || (betweenBB[kingSq][rookSq] &
+                    occupiedBB)) {
+            return false;
+        }
+        for (int sq = start; sq != end; sq += (kingSide ? 1 : -1)) {
+            if (attacked(sq, other)) {
+                return false;
+            }
+        }
+        return !attacked(end, other);
+    }
+
+    if (piece == nPawn) {
+        bool lastRank = (end >= A8 || end <= H1);
+        if (m.isPromotion() != lastRank) {
+            return false;
+        }
+        if (m.isCapture()) {
+            return pawnAttacks[toMove][start] & sqToBB[end];
+        }
+        if (flags == 1) {
+            int secondRank = (toMove == nWhite ? 1 : 6);
+            return start / 8 == secondRank && end == start + 2 * up &&
+                getPiece(start + up) == PIECE_NONE;
+        }
+        return end == start + up;
+    }
+
+    if (flags != 0 && flags != 4) {
+        return false;
+    }
+    Bitboard attacks;
+    switch (piece) {
+        case nKnight:
+            attacks = knightAttacks[start];
+            break;
+        case nBishop:
+            attacks = slidingAttacksBB<nBishop>(start, occupiedBB);
+            break;
+        case nRook:
+            attacks = slidingAttacksBB<nRook>(start, occupiedBB);
+            break;
+        case nQueen:
+            attacks = slidingAttacksBB<nQueen>(start, occupiedBB);
+            break;
+        default:
+            attacks = kingAttacks[start];
+            break;
+    }
+    return attacks & sqToBB[end];
+}
+
+
 // Checks if a pseudo-legal move is legal
 bool Board::isLegal(Move m) const {
     int start = m.getFrom();
@@ -896,7 +1182,7 @@ bool Board::isLegal(Move m) const {
         return false;
     }
     if (m.getFlags() == 5) { // en passant
-        if (end != enPassant.top()) {
+        if (end != states[statePly].enPassant) {
             return false;
         }
         if (endColor != COLOR_NONE || startPiece != nPawn) {
@@ -912,6 +1198,13 @@ bool Board::isLegal(Move m) const {
         Bitboard rooksQueens = (pieceBB[nRook + 2] | pieceBB[nQueen + 2]) &
             pieceBB[other];
         Bitboard kingLoc = pieceBB[nKing + 2] & pieceBB[startColor];
+        int kingSquare = lsb(kingLoc);
+        // a knight or another pawn giving check is not resolved
+        if ((knightAttacks[kingSquare] & getPieces(other, nKnight)) ||
+                (pawnAttacks[startColor][kingSquare] & getPieces(other, nPawn) &
+                 ~sqToBB[pawnSq])) {
+            return false;
+        }
         Bitboard newOccupied = occupiedBB ^ sqToBB[start] ^ sqToBB[end] ^ sqToBB[pawnSq];
         return !(allSlidingAttacks<nBishop>(bishopsQueens, newOccupied) & kingLoc) &&
                 !(allSlidingAttacks<nRook>(rooksQueens, newOccupied) & kingLoc);
@@ -920,10 +1213,17 @@ bool Board::isLegal(Move m) const {
 
     if (startPiece == nKing) {
         return m.getFlags() == 2 || m.getFlags() == 3 || !attacked((Square)m.getTo(),
-                other);
+                other, occupiedBB ^ sqToBB[start]);
     }
 
     int kingSquare = lsb(getPieces(toMove, nKing));
+
+    // in check, the move has to capture the only checker or block it
+    Bitboard checkers = getCheckers();
+    if (checkers && ((checkers & (checkers - 1)) || !((betweenBB[lsb(checkers)]
+                        [kingSquare] | checkers) & sqToBB[end]))) {
+        return false;
+    }
     if (!(pinnedPieces((getPieces(nBishop) | getPieces(nRook) | getPieces(nQueen)) &
             getPieces(other), (Square)kingSquare) & sqToBB[start])) {
         return true;
@@ -933,34 +1233,28 @@ bool Board::isLegal(Move m) const {
 }
 
 
-// Gets an entry from the transposition table
-HashEntry Board::getTransTable(int key) const {
-    return transTable[key];
-}
-
-
-// Updates an entry in the transposition table
-void Board::setTransTable(int key, HashEntry entry) {
-   transTable[key] = entry;
-}
-
-
 // Returns whether this position has been repeated at some point
 bool Board::isRep() {
-    unsigned long long z = zobrist.back();
-    zobrist.pop_back();
-    bool rep = find(zobrist.begin(), zobrist.end(), z) != zobrist.end();
-    zobrist.push_back(z);
-    return rep;
+    // only positions with the same side to move since the last capture or
+    // pawn move can repeat
+    unsigned long long z = states[statePly].zobrist;
+    int oldest = std::max(0, statePly - states[statePly].fiftyMove);
+    for (int i = statePly - 2; i >= oldest; i -= 2) {
+        if (states[i].zobrist == z) {
+            return true;
+        }
+    }
+    return false;
 }
 
 
 // Prints out the principal variation up to a given depth
 void Board::printPV(int depth) {
-    HashEntry tt = getTransTable(getZobrist() % 100000);
+    HashEntry tt;
+    bool found = TT.probe(getZobrist(), tt);
     Move m = tt.move;
-    if (tt.nodeType != HASH_NULL && !(m == Move()) && depth != 0) {
-        if (isLegal(m)) {
+    if (found && !(m == Move()) && depth != 0) {
+        if (isPseudoLegal(m) && isLegal(m)) {
             makeMove(m);
             cout << " " << tt.move.toStr();
             printPV(depth - 1);
@@ -1037,60 +1331,25 @@ void Board::printBoard() const {
 }
 
 
-// Returns the evaluation of the board's score
+// Returns the evaluation of the board's score. Every term is a packed mid
+// game and end game score, so the terms are summed once and the total is
+// tapered by the game phase at the end.
 int Board::boardScore() const {
-    int endgameScore = materialCount(nWhite, true) - materialCount(nBlack,
-            true);
-    int openScore = materialCount(nWhite, false) - materialCount(nBlack,
-            false);
-    int phase = boardPhase();
-    int score = ((openScore * (256 - phase)) + (endgameScore * phase)) / 256;
-    score -= 12 * (getIsolatedPawns(nWhite) - getIsolatedPawns(nBlack));
-    score -= 15 * (getBackwardPawns(nWhite) - getBackwardPawns(nBlack));
-    score -= 18 * (getDoubledPawns(nWhite) - getDoubledPawns(nBlack));
-    score += (mobilityScore(nWhite) - mobilityScore(nBlack));
-    score += (passedScore(nWhite) - passedScore(nBlack));
-    score += (safetyScore(nWhite) - safetyScore(nBlack));
-
-    return (toMove == nWhite ? score : -score);
-}
-
+    const StateInfo* st = &states[statePly];
+    Score score = st->material[nWhite] - st->material[nBlack];
+    PawnInfo pawns;
+    getPawnInfo(pawns);
+    score -= isolatedPenalty * (pawns.isolated[nWhite] - pawns.isolated[nBlack]);
+    score -= backwardPenalty * (pawns.backward[nWhite] - pawns.backward[nBlack]);
+    score -= doubledPenalty * (pawns.doubled[nWhite] - pawns.doubled[nBlack]);
+    score += mobilityScore(nWhite) - mobilityScore(nBlack);
+    score += passedScore(nWhite, pawns.passed[nWhite]) -
+            passedScore(nBlack, pawns.passed[nBlack]);
+    score += safetyScore(nWhite) - safetyScore(nBlack);
 
-int Board::boardPhase() const {
-    int totalPhase = 32;
-    int phase = totalPhase;
-
-    phase -= popcount(getPieces(nKnight));
-    phase -= popcount(getPieces(nBishop));
-    phase -= popcount(getPieces(nRook)) * 2;
-    phase -= popcount(getPieces(nQueen)) * 4;
-
-    return (phase * 256 + (totalPhase / 2)) / totalPhase;
-}
-// Returns the amount of material for the given color
-int Board::materialCount(Color c, bool endgame) const {
-    int score = 0;
-    for (int p = nPawn; p <= nKing; p++) {
-        Bitboard pieces = getPieces(c, (Piece)p);
-        while (pieces) {
-            Square sq = pop_lsb(&pieces);
-            score += PieceVals[p];
-            if (c == nWhite) {
-                if (p == nKing && endgame) {
-                    score += kingTableEndgame[sq];
-                } else {
-                    score += pieceTable[p][sq];
-                }
-            } else {
-                if (p == nKing && endgame) {
-                    score += kingTableEndgame[8 * (7 - sq / 8) + (sq & 7)];
-                } else {
-                    score += pieceTable[p][8 * (7 - sq / 8) + (sq & 7)];
-                }
-            }
-        }
-    }
-    return score;
+    int phase = boardPhase();
+    int value = (mgValue(score) * (256 - phase) + egValue(score) * phase) / 256;
+    return (toMove == nWhite ? value : -value);
 }
 
 
@@ -1184,37 +1443,59 @@ bool Board::isPasser(Square sq) const {
 }
 
 
-// Returns the passed pawn score for the given color
-int Board::passedScore(Color c) const {
-    int score = 0;
+// Fills in the pawn structure evaluation, looking it up by the pawn key and
+// computing and storing it on a miss
+void Board::getPawnInfo(PawnInfo& info) const {
+    if (pawnTable.probe(getPawnKey(), info)) {
+        return;
+    }
+    for (int color = nWhite; color <= nBlack; color++) {
+        Color c = (Color)color;
+        info.isolated[c] = getIsolatedPawns(c);
+        info.doubled[c] = getDoubledPawns(c);
+        info.backward[c] = getBackwardPawns(c);
+        info.passed[c] = 0;
+        Bitboard pawns = getPieces(c, nPawn);
+        while (pawns) {
+            Square square = pop_lsb(&pawns);
+            if (isPasser(square)) {
+                info.passed[c] |= sqToBB[square];
+            }
+        }
+    }
+    pawnTable.store(getPawnKey(), info);
+}
+
+
+// Returns the passed pawn score for the given color and its passers
+Score Board::passedScore(Color c, Bitboard passers) const {
+    Score score = 0;
     int up = (c == nWhite ? 8 : -8);
     Color other = (c == nWhite ? nBlack : nWhite);
 
-    Bitboard pawns = getPieces(c, nPawn);
-    while (pawns != 0) {
-        Square square = pop_lsb(&pawns);
-        if (isPasser(square)) {
-            int rank = square / 8;
-            if (c == nBlack) rank = 7 - rank;
-            score += passedRank[rank];
-            score += min(square % 8 + 1, 8 - square % 8);
-
-            // TODO: Add static exchange evaluation for bonus
-            if (getFile(square) & (getPieces(c, nRook) |
-                        getPieces(c, nQueen)) & pawnFrontSpan[other][square]) {
-                score += passedRank[rank] * 0.17;
-            } 
-            if (getFile(square) & (getPieces(other, nRook) |
-                        getPieces(other, nQueen)) & pawnFrontSpan[other][square]) {
-                score -= passedRank[rank] * 0.17;
-            } 
-            square = (Square)((int)square + up);
-            while (square > H1 && square < A8) {
-                if (getColor(square) == other) {
-                    score -= 5;
-                }
-                square = (Square)((int)square + up);
+    while (passers != 0) {
+        Square square = pop_lsb(&passers);
+        int rank = square / 8;
+        if (c == nBlack) rank = 7 - rank;
+        score += passedRank[rank];
+        int edge = min(square % 8 + 1, 8 - square % 8);
+        score += makeScore(edge, edge);
+
+        // TODO: Add static exchange evaluation for bonus
+        if (getFile(square) & (getPieces(c, nRook) |
+                    getPieces(c, nQueen)) & pawnFrontSpan[other][square]) {
+            score += passedRookBehind[rank];
+        } 
+        if (getFile(square) & (getPieces(other, nRook) |
+                    getPieces(other, nQueen)) & pawnFrontSpan[other][square]) {
+            score -= passedRookBehind[rank];
+        } 
+        square = (Square)((int)square + up);
+        while (square > H1 && square < A8) {
+            if (getColor(square) == other) {
+                score -= passedBlocked;
             }
+            square = (Square)((int)square + up);
         }
     }
     return score;
@@ -1222,8 +1503,8 @@ int Board::passedScore(Color c) const {
 
 
 // Returns the mobility score for the given color
-int Board::mobilityScore(Color c) const {
-    int count = 0;
+Score Board::mobilityScore(Color c) const {
+    Score count = 0;
     for (int sq = A1; sq <= H8; sq++) {
         if (getColor(sq) == c) {
             Piece p = getPiece(sq);
@@ -1265,7 +1546,7 @@ int Board::mobilityScore(Color c) const {
 
 
 // Returns the king safety score for the given color
-int Board::safetyScore(Color c) const {
+Score Board::safetyScore(Color c) const {
     int count = 0;
     Color opp = (c == nWhite ? nBlack : nWhite);
     int up = (c == nWhite ? 8 : -8);
@@ -1291,5 +1572,5 @@ int Board::safetyScore(Color c) const {
         }
     }
 
-    return -safetyTable[count];
+    return makeScore(-safetyTable[count], -safetyTable[count]);
 }
@@ -3,15 +3,36 @@
 
 #include <iostream>
 #include <vector>
-#include <stack>
 #include <sstream>
 #include <cassert>
 #include <algorithm>
 #include "bitboard.hpp"
 #include "move.hpp"
+#include "tt.hpp"
+#include "pawns.hpp"
 
-const int SEARCH_DEPTH = 6;
-enum TABLE_SIZE {TABLE_SIZE = 100000};
+
+// Holds a mid game and an end game value packed into one integer, the end
+// game value in the upper 16 bits. Packed scores are added, subtracted and
+// scaled by integers as a whole, so each term is summed once and the total
+// is tapered by the game phase at the end.
+typedef int Score;
+
+// Returns the packed score of the given mid game and end game values
+constexpr Score makeScore(int mg, int eg) {
+    return (int)((unsigned int)eg << 16) + mg;
+}
+
+// Returns the mid game half of a packed score
+inline int mgValue(Score s) {
+    return (short)(unsigned short)(unsigned int)s;
+}
+
+// Returns the end game half of a packed score, rounding up to undo the borrow
+// a negative mid game half takes from it
+inline int egValue(Score s) {
+    return (short)(unsigned short)((unsigned int)(s + 0x8000) >> 16);
+}
 
 const short pieceTable[6][64] = {
     // pawn
@@ -95,11 +116,56 @@ const short kingTableEndgame[] =
     -50,-30,-30,-30,-30,-30,-30,-50
 };
 
-const int knightMob[9] = {-75,-57,-9,-2,6,14,22,29,36};
-const int bishopMob[14] = {-48,-20,16,26,38,51,55,63,63,68,81,81,91,98};
-const int rookMob[15] = {-58,-27,-15,-10,-5,-2,9,16,30,29,32,38,46,48,58};
-const int queenMob[28] = {-39,-21,3,3,14,22,28,41,43,48,56,60,60,66,67,70,71,73,79,88,88,99,102,102,106,109,113,116};
-const int passedRank[7] = {0, 5, 5, 30, 70, 170, 350};
+// mobility scores, indexed by the number of safe squares a piece attacks
+const Score knightMob[9] = {
+    makeScore(-75,-75), makeScore(-57,-57), makeScore(-9,-9), makeScore(-2,-2),
+    makeScore(6,6), makeScore(14,14), makeScore(22,22), makeScore(29,29),
+    makeScore(36,36)
+};
+const Score bishopMob[14] = {
+    makeScore(-48,-48), makeScore(-20,-20), makeScore(16,16), makeScore(26,26),
+    makeScore(38,38), makeScore(51,51), makeScore(55,55), makeScore(63,63),
+    makeScore(63,63), makeScore(68,68), makeScore(81,81), makeScore(81,81),
+    makeScore(91,91), makeScore(98,98)
+};
+const Score rookMob[15] = {
+    makeScore(-58,-58), makeScore(-27,-27), makeScore(-15,-15),
+    makeScore(-10,-10), makeScore(-5,-5), makeScore(-2,-2), makeScore(9,9),
+    makeScore(16,16), makeScore(30,30), makeScore(29,29), makeScore(32,32),
+    makeScore(38,38), makeScore(46,46), makeScore(48,48), makeScore(58,58)
+};
+const Score queenMob[28] = {
+    makeScore(-39,-39), makeScore(-21,-21), makeScore(3,3), makeScore(3,3),
+    makeScore(14,14), makeScore(22,22), makeScore(28,28), makeScore(41,41),
+    makeScore(43,43), makeScore(48,48), makeScore(56,56), makeScore(60,60),
+    makeScore(60,60), makeScore(66,66), makeScore(67,67), makeScore(70,70),
+    makeScore(71,71), makeScore(73,73), makeScore(79,79), makeScore(88,88),
+    makeScore(88,88), makeScore(99,99), makeScore(102,102),
+    makeScore(102,102), makeScore(106,106), makeScore(109,109),
+    makeScore(113,113), makeScore(116,116)
+};
+
+// passed pawn scores, indexed by relative rank
+const Score passedRank[7] = {
+    makeScore(0,0), makeScore(5,5), makeScore(5,5), makeScore(30,30),
+    makeScore(70,70), makeScore(170,170), makeScore(350,350)
+};
+// passed pawn bonus for a rook or queen behind it, indexed by relative rank
+const Score passedRookBehind[7] = {
+    makeScore(0,0), makeScore(0,0), makeScore(0,0), makeScore(5,5),
+    makeScore(11,11), makeScore(28,28), makeScore(59,59)
+};
+// passed pawn penalty for each enemy piece in front of it
+const Score passedBlocked = makeScore(5, 5);
+
+// pawn structure penalties
+const Score isolatedPenalty = makeScore(12, 12);
+const Score backwardPenalty = makeScore(15, 15);
+const Score doubledPenalty = makeScore(18, 18);
+
+// weight of each piece in the game phase; knights, bishops, rooks and queens
+// of both sides add up to 24 out of 32 at the start
+const int phaseWeight[6] = {0, 1, 1, 2, 4, 0};
 
 // from chess programming wikispaces
 const int safetyTable[100] = {
@@ -117,41 +183,49 @@ const int safetyTable[100] = {
 
 
 
-enum HashType {
-    HASH_EXACT,
-    HASH_ALPHA,
-    HASH_BETA,
-    HASH_NULL
-};
+// Holds the zobrist keys. They are generated from a fixed seed at build time
+// into tables.cpp by tools/gentables.cpp, so every process hashes a position
+// to the same key and needs no set up.
+namespace Zobrist {
+    // indexed by 6 * color + piece, then square
+    extern const unsigned long long pieces[12][64];
+    extern const unsigned long long blackMove;
+    extern const unsigned long long castling[4];
+    // indexed by the file of the en passant square
+    extern const unsigned long long enPassant[8];
+}
 
-struct HashEntry {
-    unsigned long long zobrist;
-    int depth;
-    int score;
-    bool ancient;
-    HashType nodeType;
-    Move move;
-
-    HashEntry(unsigned long long zobrist, int depth, int score, bool ancient,
-            HashType nodeType, Move move) {
-        this->zobrist = zobrist;
-        this->depth = depth;
-        this->score = score;
-        this->ancient = ancient;
-        this->nodeType = nodeType;
-        this->move = move;
-    }
+// Maximum number of plies, including the search, a board can hold
+const int MAX_GAME_PLY = 1024;
 
-    HashEntry() {
-        this->zobrist = 0;
-        this->depth = 0;
-        this->score = 0;
-        this->ancient=true;
-        this->nodeType=HASH_NULL;
-        this->move = Move();
-    }
+// Holds the irreversible parts of a position, which makeMove saves for every
+// ply so unmakeMove can restore them
+struct StateInfo {
+    // En passant target square
+    Square enPassant;
+    // Holds the castling rights:
+    // white CAN castle kingside
+    // white CAN'T castle queenside
+    // black CAN castle kingside
+    // black CAN castle queenside
+    short castling;
+    // Holds the fifty move counter
+    int fiftyMove;
+    // Holds the piece captured by the move leading to this position
+    Piece captured;
+    // Holds the zobrist key
+    unsigned long long zobrist;
+    // Holds the zobrist key of the pawns alone
+    unsigned long long pawnKey;
+    // Holds the packed material and piece square score of each color
+    Score material[2];
+    // Holds the sum of the phase weights of the pieces on the board
+    int phaseWeight;
 };
 
+// Holds the mailbox encoding of an empty square, see Board::toSquare
+const unsigned char EMPTY_SQUARE = PIECE_NONE | (COLOR_NONE << 3);
+
 class Board {
     // Holds bitboards for the different colors and types of pieces
     Bitboard pieceBB[8];    
@@ -159,29 +233,33 @@ class Board {
     Bitboard emptyBB;
     // Bitboard that is 1 for all the occupied squares
     Bitboard occupiedBB;
-    // En passant target square
-    std::stack<Square> enPassant;
-    // Holds the castling rights:
-    // white CAN castle kingside
-    // white CAN'T castle queenside
-    // black CAN castle kingside
-    // black CAN castle queenside
-    std::stack<short> castling;
     // Holds the color of the side to move
     Color toMove;
-    // Holds the fifty move counter
-    std::stack<int> fiftyList;
-    // holds the list of captured pieces
-    std::stack<Piece> capturedList;
     // holds the full move counter
     int fullMove;
-    // holds the zobrist keys
-    std::vector<unsigned long long> zobrist;
-    // holds the transposition table
-    HashEntry transTable[TABLE_SIZE];
+    // Holds the state of every position reached since the last
+    // setPosition, indexed by ply
+    StateInfo states[MAX_GAME_PLY];
+    // Holds the index of the current position's state
+    int statePly;
+    // Holds the piece and color on every square, kept in step with the
+    // bitboards so single squares can be looked up directly
+    unsigned char mailbox[64];
+
+    // Returns the mailbox encoding of a piece of the given color
+    static inline unsigned char toSquare(Piece p, Color c) {
+        return p | (c << 3);
+    }
+
+    // Fills the mailbox from the piece bitboards
+    void setMailbox();
+
+    // Sets the material scores of the current state from the piece bitboards
+    void setMaterial();
+
+    // Copies the position and the states up to the current ply of a board
+    void copyFrom(const Board& other);
 public:
-    // Holds the killer moves list
-    Move killerMoves[SEARCH_DEPTH + 1][2];
     // holds the list of moves
     std::vector<Move> moveList;
     /**
@@ -196,6 +274,12 @@ public:
      */
     Board(std::string FEN);
 
+    // Copies a board. Only the states up to the current ply are copied, so a
+    // copy costs the depth of the game, not the whole state stack.
+    Board(const Board& other);
+
+    Board& operator=(const Board& other);
+
     // Sets the board's Zobrist key to the one for the given position
     void setZobrist();
 
@@ -215,10 +299,14 @@ public:
     Bitboard getPieces(Color ct, Piece pt) const;
 
     // Returns the piece on a given square
-    Piece getPiece(int sq) const;
+    inline Piece getPiece(int sq) const {
+        return (Piece)(mailbox[sq] & 7);
+    }
 
     // Returns the color of the piece on the given square
-    Color getColor(int sq) const;
+    inline Color getColor(int sq) const {
+        return (Color)(mailbox[sq] >> 3);
+    }
 
     // Returns a bitboard representing the file the current square is on.
     Bitboard getFile(Square sq) const;
@@ -250,19 +338,38 @@ public:
     // Returns the zobrist hash key
     unsigned long long getZobrist() const;
 
+    // Returns the zobrist key of the pawns alone
+    unsigned long long getPawnKey() const;
+
     // Returns the fifty move counter
     int getFiftyCount() const;
 
     // Returns whether a square is attacked by a given side
     bool attacked(int square, Color side) const;
 
+    // Returns whether a square is attacked by a given side, with sliding
+    // attacks blocked only by the given occupancy
+    bool attacked(int square, Color side, Bitboard occupied) const;
+
     // Returns a bitboard holding the pieces attacking the square of the given
     // color
     Bitboard getAttackers(Square sq, Color c) const;
 
+    // Returns a bitboard holding the pieces of both colors attacking the
+    // square, with sliding attacks blocked only by the given occupancy
+    Bitboard attackersTo(Square sq, Bitboard occupied) const;
+
     // Returns a color's least valuable attacker of a square
     Square lva(Square sq, Color side) const;
 
+    // Returns the material the side to move wins with a capture once every
+    // recapture on the square has been played out
+    int see(Move m) const;
+
+    // Returns whether the static exchange value of a move is at least the
+    // threshold, stopping as soon as the outcome is known
+    bool seeGe(Move m, int threshold) const;
+
     // Returns whether the player to move is in check or not
     bool inCheck() const;
 
@@ -287,15 +394,13 @@ public:
     // Unmakes a null move for the current position
     void unmakeNullMove();
 
+    // Checks if a move, possibly taken from another position, could be
+    // generated in this one ignoring whether it leaves the king in check
+    bool isPseudoLegal(Move m) const;
+
     // Checks if a pseudo-legal move is legal
     bool isLegal(Move m) const;
 
-    // Gets an entry from the transposition table
-    HashEntry getTransTable(int key) const;
-
-    // Updates an entry in the transposition table
-    void setTransTable(int key, HashEntry entry);
-
     // Returns whether this position has been repeated at some point
     bool isRep();
 
@@ -308,11 +413,21 @@ public:
     // Returns the evaluation of the board's score
     int boardScore() const;
 
-    // Returns an integer representing the game phase
-    int boardPhase() const;
+    // Returns the game phase, the weight of the endgame scores out of 256.
+    // It is 64 in the starting position, since the phase weights of all the
+    // pieces add up to 24 of 32, and rises to 256 once the knights, bishops,
+    // rooks and queens are gone. The phase weights are kept up to date by
+    // makeMove, so this is a subtraction and a shift.
+    inline int boardPhase() const {
+        return 8 * (32 - std::min(states[statePly].phaseWeight, 32));
+    }
 
-    // Returns the amount of material for the given color
-    int materialCount(Color c, bool endgame) const;
+    // Returns the amount of material for the given color, including the
+    // piece square tables, kept up to date by makeMove
+    inline int materialCount(Color c, bool endgame) const {
+        Score material = states[statePly].material[c];
+        return (endgame ? egValue(material) : mgValue(material));
+    }
 
     // Returns the number of isp
     int getIsolatedPawns(Color c) const;
@@ -326,14 +441,17 @@ public:
     // Returns whether a square has a candidate passer or not
     bool isPasser(Square sq) const;
 
-    // Returns the passed pawn score for the given color
-    int passedScore(Color c) const;
+    // Fills in the pawn structure evaluation, from the pawn table if possible
+    void getPawnInfo(PawnInfo& info) const;
+
+    // Returns the passed pawn score for the given color and its passers
+    Score passedScore(Color c, Bitboard passers) const;
 
     // Returns the mobility score for the given color
-    int mobilityScore(Color c) const;
+    Score mobilityScore(Color c) const;
 
     // Returns the king safety score for the given color
-    int safetyScore(Color c) const;
+    Score safetyScore(Color c) const;
 };
 
 #endif // #ifndef BOARD
@@ -0,0 +1,44 @@
+#include "evalcache.hpp"
+
+EvalCache evalCache;
+
+// Mask of the key bits stored in an entry
+static const unsigned long long KEY_MASK = ~0xffffULL;
+
+EvalCache::EvalCache() {
+    table = new std::atomic<unsigned long long>[EVAL_CACHE_SIZE];
+    clear();
+}
+
+
+EvalCache::~EvalCache() {
+    delete[] table;
+}
+
+
+// Empties every entry in the cache. An empty entry could only match a key
+// whose upper 48 bits are all zero.
+void EvalCache::clear() {
+    for (size_t i = 0; i < EVAL_CACHE_SIZE; i++) {
+        table[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+// Looks up the given key, copying the evaluation and returning true on a hit
+bool EvalCache::probe(unsigned long long key, int& eval) const {
+    unsigned long long data =
+        table[key & (EVAL_CACHE_SIZE - 1)].load(std::memory_order_relaxed);
+    if ((data & KEY_MASK) != (key & KEY_MASK)) {
+        return false;
+    }
+    eval = (short)(data & 0xffff);
+    return true;
+}
+
+
+// Stores the evaluation of the given key, replacing whatever was there
+void EvalCache::store(unsigned long long key, int eval) {
+    table[key & (EVAL_CACHE_SIZE - 1)].store((key & KEY_MASK) |
+            (unsigned short)eval, std::memory_order_relaxed);
+}
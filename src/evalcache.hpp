@@ -0,0 +1,34 @@
+#ifndef EVALCACHE_HPP
+#define EVALCACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+// Number of entries in the evaluation cache, a power of two
+const size_t EVAL_CACHE_SIZE = 1 << 16;
+
+// Caches static evaluations keyed by zobrist key. Each entry is a single
+// word holding the upper 48 bits of the key and the 16 bit evaluation, so
+// threads share the table without locking and can never read a torn entry.
+class EvalCache {
+    std::atomic<unsigned long long>* table;
+public:
+    EvalCache();
+
+    ~EvalCache();
+
+    // Empties every entry in the cache
+    void clear();
+
+    // Looks up the given key, copying the evaluation and returning true on a
+    // hit
+    bool probe(unsigned long long key, int& eval) const;
+
+    // Stores the evaluation of the given key
+    void store(unsigned long long key, int eval);
+};
+
+// The evaluation cache shared by every search
+extern EvalCache evalCache;
+
+#endif
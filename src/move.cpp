@@ -20,14 +20,20 @@ Move::Move(unsigned int from, unsigned int to, unsigned int flags) {
 }
 
 
+// Constructs a Move object from its 16 bit encoding
+Move::Move(unsigned short data) {
+    move = data;
+}
+
+
 // Overloads equal operator for Move objects
-bool Move::operator==(const Move& other) {
+bool Move::operator==(const Move& other) const {
     return other.move == move;
 }
 
 
 // Overloads unequal operator for Move objects
-bool Move::operator!=(const Move& other) {
+bool Move::operator!=(const Move& other) const {
     return other.move != move;
 }
 
@@ -60,3 +66,9 @@ bool Move::isCapture() const {
 bool Move::isPromotion() const {
     return (move >> 15) & 1;
 }
+
+
+// Returns the 16 bit encoding of the move
+unsigned short Move::getData() const {
+    return move & 0xffff;
+}
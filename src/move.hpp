@@ -13,11 +13,14 @@ public:
     // Constructs a new Move object holding given squares and flags.
     Move(unsigned int from, unsigned int to, unsigned int flags);
 
+    // Constructs a Move object from its 16 bit encoding
+    explicit Move(unsigned short data);
+
     // Overloads equal operator for Move objects
-    bool operator==(const Move& other);
+    bool operator==(const Move& other) const;
 
     // Overloads unequal operator for Move objects
-    bool operator!=(const Move& other);
+    bool operator!=(const Move& other) const;
 
     friend std::ostream& operator<<(std::ostream& os, const Move& mv) {
         os << squareNames[mv.getFrom()] << " " << squareNames[mv.getTo()] << " " <<
@@ -50,6 +53,73 @@ public:
 
     // Returns true iff a move is a promotion
     bool isPromotion() const;
+
+    // Returns the 16 bit encoding of the move
+    unsigned short getData() const;
 };
 
+// Maximum number of moves in any chess position is 218, rounded up
+const int MAX_MOVES = 256;
+
+// Holds up to MAX_MOVES elements in fixed storage, so filling a list during
+// move generation or ordering never allocates
+template<typename T>
+class StackList {
+    T items[MAX_MOVES];
+    unsigned int count;
+public:
+    StackList() : count(0) {}
+
+    // Appends an element to the end of the list
+    inline void push_back(const T& item) {
+        items[count++] = item;
+    }
+
+    // Returns the number of elements in the list
+    inline unsigned int size() const {
+        return count;
+    }
+
+    // Returns whether the list holds no elements
+    inline bool empty() const {
+        return count == 0;
+    }
+
+    // Removes every element
+    inline void clear() {
+        count = 0;
+    }
+
+    // Shrinks the list to the given number of elements
+    inline void resize(unsigned int size) {
+        count = size;
+    }
+
+    inline T& operator[](unsigned int i) {
+        return items[i];
+    }
+
+    inline const T& operator[](unsigned int i) const {
+        return items[i];
+    }
+
+    inline T* begin() {
+        return items;
+    }
+
+    inline T* end() {
+        return items + count;
+    }
+
+    inline const T* begin() const {
+        return items;
+    }
+
+    inline const T* end() const {
+        return items + count;
+    }
+};
+
+typedef StackList<Move> MoveList;
+
 #endif
@@ -4,7 +4,6 @@
 #include "board.hpp"
 #include "move.hpp"
 #include "bitboard.hpp"
-#include <vector>
 #include <algorithm>
 
 using namespace std;
@@ -12,18 +11,63 @@ using namespace std;
 
 enum MoveType {
     ALL,
-    EVASIONS, 
-    CAPTURES,
-    QUIET
+    CAPTURES, // captures and promotions
+    QUIET     // all other moves
 };
 
+// Holds what the legal move generators need to know about the king of the
+// side to move, computed once per position
+struct KingInfo {
+    // square of the king
+    Square square;
+    // pieces giving check
+    Bitboard checkers;
+    // pieces of the side to move pinned to the king
+    Bitboard pinned;
+    // squares a non-king move must end on: anywhere when not in check,
+    // otherwise the checker or a square between it and the king
+    Bitboard checkMask;
+
+    template<Color c>
+    void init(const Board& b) {
+        constexpr Color other = (c == nWhite ? nBlack : nWhite);
+        square = lsb(b.getPieces(c, nKing));
+        checkers = b.getCheckers();
+        pinned = b.pinnedPieces(b.getPieces(other), square) & b.getPieces(c);
+        if (!checkers) {
+            checkMask = ~0ULL;
+        } else if (checkers & (checkers - 1)) { // double check
+            checkMask = 0;
+        } else {
+            checkMask = betweenBB[lsb(checkers)][square] | checkers;
+        }
+    }
+
+    // Returns the squares a piece on the given square may move to without
+    // leaving the king in check
+    inline Bitboard legalTargets(int sq) const {
+        return (pinned & sqToBB[sq]) ? checkMask & lineBB[square][sq] :
+            checkMask;
+    }
+};
+
+// Returns the squares moves of the given type may end on
 template<Color c, MoveType mv>
-void getPawnMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
-    Bitboard pawns = b.getPieces(c, nPawn);
+inline Bitboard moveTargets(const Board& b) {
+    constexpr Color other = (c == nWhite ? nBlack : nWhite);
+    return (mv == CAPTURES ? b.getPieces(other) :
+           (mv == QUIET ? b.getEmpty() : ~b.getPieces(c)));
+}
+
+// Appends the moves of the given pawns that end on a target square. All
+// promotions count as captures.
+template<Color c, MoveType mv>
+void getPawnMoves(MoveList &moveList, Board &b, Bitboard pawns, Bitboard
+        targets) {
     Bitboard empty = b.getEmpty();
     Bitboard other = (c == nWhite ? b.getPieces(nBlack) : b.getPieces(nWhite));
     Bitboard fourthRank = (c == nWhite ? Rank4 : Rank5);
-    Square enPassant = b.enPassantTarget();
+    Bitboard lastRank = (c == nWhite ? Rank8 : Rank1);
 
     constexpr Direction up = (c == nWhite ? NORTH : SOUTH);
     constexpr Direction upRight = (c == nWhite ? NORTH_EAST : SOUTH_WEST);
@@ -31,43 +75,26 @@ void getPawnMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
 
     Bitboard singleMoves = shift<up>(pawns) & empty;
     Bitboard doubleMoves = (shift<up>(singleMoves) & fourthRank) & empty;
-    Bitboard attacksLeft = shift<upLeft>(pawns);
-    Bitboard attacksRight = shift<upRight>(pawns);
-
+    Bitboard attacksLeft = shift<upLeft>(pawns) & other & targets;
+    Bitboard attacksRight = shift<upRight>(pawns) & other & targets;
+    singleMoves &= targets;
+    doubleMoves &= targets;
 
-    singleMoves = (mv == EVASIONS ? singleMoves & targets : singleMoves);
-    doubleMoves = (mv == EVASIONS ? doubleMoves & targets : doubleMoves);
-    attacksLeft = (mv == EVASIONS ? attacksLeft & targets : attacksLeft);
-    attacksRight = (mv == EVASIONS ? attacksRight & targets : attacksRight);
-
-    // en passant
     if (mv != QUIET) {
-        if (enPassant != SQ_NONE) {
-            if (sqToBB[enPassant] & attacksLeft) {
-                moveList.push_back(Move(enPassant - upLeft, enPassant, 5)); 
-            }
-            if (sqToBB[enPassant] & attacksRight) {
-                moveList.push_back(Move(enPassant - upRight, enPassant, 5)); 
+        Bitboard promotions = singleMoves & lastRank;
+        while (promotions) {
+            int index = pop_lsb(&promotions);
+            for (int flag = 8; flag <= 11; flag++) {
+                moveList.push_back(Move(index - up, index, flag));
             }
         }
     }
 
-    attacksLeft &= other;
-    attacksRight &= other;
-
-    // single pawn moves
     if (mv != CAPTURES) {
+        singleMoves &= ~lastRank;
         while (singleMoves) {
             int index = pop_lsb(&singleMoves);
-            if (index >= A8 || index <= H1) { // promotion
-                if (mv != QUIET) {
-                    for (int flag = 8; flag <= 11; flag++) {
-                        moveList.push_back(Move(index - up, index, flag));
-                    }
-                }
-            } else {
-                moveList.push_back(Move(index - up, index, 0));
-            }
+            moveList.push_back(Move(index - up, index, 0));
         }
 
         while (doubleMoves) {
@@ -79,7 +106,7 @@ void getPawnMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
     if (mv != QUIET) {
         while (attacksLeft) {
             int index = pop_lsb(&attacksLeft);
-            if (index >= A8 || index <= H1) {
+            if (sqToBB[index] & lastRank) {
                 for (int flag = 12; flag <= 15; flag++) {
                     moveList.push_back(Move(index - upLeft, index, flag));
                 }
@@ -90,7 +117,7 @@ void getPawnMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
 
         while (attacksRight) {
             int index = pop_lsb(&attacksRight);
-            if (index >= A8 || index <= H1) {
+            if (sqToBB[index] & lastRank) {
                 for (int flag = 12; flag <= 15; flag++) {
                     moveList.push_back(Move(index - upRight, index, flag));
                 }
@@ -101,171 +128,135 @@ void getPawnMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
     }
 }
 
+// Appends the legal en passant captures. They are rare, and the only moves
+// that remove a piece off the square they land on, so each one is verified
+// with Board::isLegal instead of the pin masks.
+template<Color c>
+void getEnPassant(MoveList &moveList, Board &b, const KingInfo& king) {
+    constexpr Direction up = (c == nWhite ? NORTH : SOUTH);
+    constexpr Color other = (c == nWhite ? nBlack : nWhite);
+    Square enPassant = b.enPassantTarget();
+    if (enPassant == SQ_NONE || !(king.checkMask & (sqToBB[enPassant] |
+                    sqToBB[enPassant - up]))) {
+        return;
+    }
+
+    Bitboard pawns = pawnAttacks[other][enPassant] & b.getPieces(c, nPawn);
+    while (pawns) {
+        Move m(pop_lsb(&pawns), enPassant, 5);
+        if (b.isLegal(m)) {
+            moveList.push_back(m);
+        }
+    }
+}
+
+// Appends the moves of knights, bishops, rooks or queens that end on a
+// target square and keep the king out of check
 template<Color c, Piece p, MoveType mv>
-void getSlidingMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
+void getPieceMoves(MoveList &moveList, Board &b, const KingInfo& king) {
     Bitboard pieces = b.getPieces(c, p);
     Bitboard occupied = b.getOccupied();
-    Bitboard other = (c == nWhite ? b.getPieces(nBlack) : b.getPieces(nWhite));
+    Bitboard targets = moveTargets<c, mv>(b);
+    unsigned int flags = (mv == CAPTURES ? 4 : 0);
+
+    if (p == nKnight) { // a pinned knight can never move
+        pieces &= ~king.pinned;
+    }
 
     while (pieces) {
         int square = pop_lsb(&pieces);
-        // automatically finds proper valid moves
-        Bitboard attacks = slidingAttacksBB<p>(square, occupied);
-        attacks = (mv == EVASIONS ? attacks & targets : attacks);
+        Bitboard attacks = (p == nKnight ? knightAttacks[square] :
+                slidingAttacksBB<p>(square, occupied));
+        attacks &= targets & king.legalTargets(square);
         while (attacks) {
             int attackSquare = pop_lsb(&attacks);
-            if ((sqToBB[attackSquare] & other) && mv != QUIET) { // other piece there
-                moveList.push_back(Move(square, attackSquare, 4)); 
-            } else if ((sqToBB[attackSquare] & ~occupied) && mv != CAPTURES) { // not a capture
-                moveList.push_back(Move(square, attackSquare, 0)); 
-            }
+            moveList.push_back(Move(square, attackSquare, mv == ALL ?
+                        (occupied & sqToBB[attackSquare] ? 4 : 0) : flags));
         }
     }
 }
 
-template<Color c, Piece p, MoveType mv>
-void getMoves(vector<Move> &moveList, Board &b, Bitboard targets) {
-    Bitboard pieces = b.getPieces(c, p); 
+// Appends the king moves to squares that are not attacked once the king has
+// left its square
+template<Color c, MoveType mv>
+void getKingMoves(MoveList &moveList, Board &b, const KingInfo& king) {
+    constexpr Color other = (c == nWhite ? nBlack : nWhite);
     Bitboard occupied = b.getOccupied();
-    Bitboard other = (c == nWhite ? b.getPieces(nBlack) : b.getPieces(nWhite));
-    
-    while (pieces) {
-        int square = pop_lsb(&pieces);
-        Bitboard attacks;
-        if (p == nKnight) {
-            attacks = knightAttacks[square];
-        } else { // king
-            attacks = kingAttacks[square];
-        }
-
-        attacks = (mv == EVASIONS ? attacks & targets : attacks);
-        while (attacks) {
-            int attackSquare = pop_lsb(&attacks);
-            if ((sqToBB[attackSquare] & other) && mv != QUIET) { // other piece there
-                moveList.push_back(Move(square, attackSquare, 4)); 
-            } else if ((sqToBB[attackSquare] & ~occupied) && mv != CAPTURES) { // not a capture
-                moveList.push_back(Move(square, attackSquare, 0)); 
-            }
+    Bitboard withoutKing = occupied ^ sqToBB[king.square];
+    Bitboard attacks = kingAttacks[king.square] & moveTargets<c, mv>(b);
+
+    while (attacks) {
+        int attackSquare = pop_lsb(&attacks);
+        if (!b.attacked(attackSquare, other, withoutKing)) {
+            moveList.push_back(Move(king.square, attackSquare,
+                        occupied & sqToBB[attackSquare] ? 4 : 0));
         }
     }
 }
 
 template<Color c>
-void getCastleMoves(vector<Move> &moveList, Board &b, bool
+void getCastleMoves(MoveList &moveList, Board &b, bool
         kingSide) {
-    short castling = b.getCastlingRights();      
+    short castling = b.getCastlingRights();
     Square start = (c == nWhite) ? E1 : E8;
     Square end = kingSide ? ((c == nWhite) ? G1 : G8) : ((c == nWhite) ? C1
-            : C8); 
+            : C8);
     Square rookSq = kingSide ? ((c == nWhite) ? H1 : H8) : ((c == nWhite) ? A1
-            : A8); 
+            : A8);
     int step = (kingSide ? WEST : EAST);
 
     Color other = (c == nWhite) ? nBlack : nWhite;
     if ((castling >> (2 * other + kingSide)) & 1) {
+        if (betweenBB[start][rookSq] & b.getOccupied()) {
+            return;
+        }
         for (int i = end; i != start; i+=step) {
             if (b.attacked((Square)i, other)) {
                 return;
             }
         }
-        if (!(betweenBB[start][rookSq] & b.getOccupied())) {
-            moveList.push_back(Move(start, end, 2 + !kingSide));
-        }
+        moveList.push_back(Move(start, end, 2 + !kingSide));
     }
 }
 
-template<Color c>
-inline void getAllEvasions(vector<Move> &moveList, Board& b, Bitboard targets) {
-    getPawnMoves<c, EVASIONS>(moveList, b, targets);
-    getMoves<c, nKnight, EVASIONS>(moveList, b, targets);
-    getSlidingMoves<c, nBishop, EVASIONS>(moveList, b, targets);
-    getSlidingMoves<c, nRook, EVASIONS>(moveList, b, targets);
-    getSlidingMoves<c, nQueen, EVASIONS>(moveList, b, targets);
-}
+// Appends the legal moves of the given type. The checkers and pinned pieces
+// are found once, so every generated move is legal without being tried.
+template<Color c, MoveType mv = ALL>
+void getLegalMoves(MoveList &moveList, Board& b) {
+    KingInfo king;
+    king.init<c>(b);
 
-template<Color c>
-inline void getCaptures(vector<Move> &moveList, Board& b) {
-    getPawnMoves<c, CAPTURES>(moveList, b, 0);
-    getMoves<c, nKnight, CAPTURES>(moveList, b, 0);
-    getMoves<c, nKing, CAPTURES>(moveList, b, 0);
-    getSlidingMoves<c, nBishop, CAPTURES>(moveList, b, 0);
-    getSlidingMoves<c, nRook, CAPTURES>(moveList, b, 0);
-    getSlidingMoves<c, nQueen, CAPTURES>(moveList, b, 0);
-    getSlidingMoves<c, nKing, CAPTURES>(moveList, b, 0);
-}
-
-// get moves to get out of check
-template<Color c>
-void getEvasions(vector<Move> &moveList, Board& b) {
-    Color other = (c == nWhite) ? nBlack : nWhite;
-    Bitboard otherBB = b.getPieces(other);
-
-    // find list of sliding checkers
-    Bitboard checkers = b.getCheckers();
-    Bitboard sliders = ~b.getPieces(other, nPawn) & ~b.getPieces(other, nKnight);
-    sliders &= checkers;
-    Bitboard sliderAttacks = 0;
-
-    int kingSquare = lsb(b.getPieces(c, nKing));
-
-    while (sliders) {
-        int attackSq = pop_lsb(&sliders);
-        sliderAttacks |= lineBB[attackSq][kingSquare] ^ sqToBB[attackSq];
+    getKingMoves<c, mv>(moveList, b, king);
+    if (!king.checkMask) { // double check, only the king can move
+        return;
     }
 
-    // generate list of king evading moves
-    Bitboard kingMoves = kingAttacks[kingSquare] & ~sliderAttacks;
-    while (kingMoves) {
-        int square = pop_lsb(&kingMoves);
-        if (sqToBB[square] & otherBB) {
-            moveList.push_back(Move(kingSquare, square, 4)); 
-        } else {
-            moveList.push_back(Move(kingSquare, square, 0)); 
-        }
+    // promotions count as captures even onto an empty square
+    Bitboard pawns = b.getPieces(c, nPawn);
+    Bitboard targets = moveTargets<c, mv>(b) & king.checkMask;
+    if (mv == CAPTURES) {
+        targets |= b.getEmpty() & (c == nWhite ? Rank8 : Rank1) &
+            king.checkMask;
     }
-
-    if (b.doubleCheck()) {
-        return;
+    getPawnMoves<c, mv>(moveList, b, pawns & ~king.pinned, targets);
+    Bitboard pinnedPawns = pawns & king.pinned;
+    while (pinnedPawns) {
+        int square = pop_lsb(&pinnedPawns);
+        getPawnMoves<c, mv>(moveList, b, sqToBB[square],
+                targets & lineBB[king.square][square]);
     }
-
-    // We know there is one checker now.
-    int checkSq = lsb(checkers);
-    Bitboard targets = betweenBB[checkSq][kingSquare] | sqToBB[checkSq];
-    getAllEvasions<c>(moveList, b, targets);
-}
-
-template<Color c>
-inline void getPseudoLegalMoves(vector<Move> &moveList, Board& b) {
-    getPawnMoves<c, ALL>(moveList, b, 0);
-    getSlidingMoves<c, nBishop, ALL>(moveList, b, 0);
-    getSlidingMoves<c, nRook, ALL>(moveList, b, 0);
-    getSlidingMoves<c, nQueen, ALL>(moveList, b, 0);
-    getMoves<c, nKnight, ALL>(moveList, b, 0);
-    getMoves<c, nKing, ALL>(moveList, b, 0);
-    getCastleMoves<c>(moveList, b, true);
-    getCastleMoves<c>(moveList, b, false);
-}
-
-template<Color c>
-inline void getAllMoves(vector<Move> &moveList, Board& b) {
-    if (b.inCheck()) {
-        getEvasions<c>(moveList, b);
-    } else {
-        getPseudoLegalMoves<c>(moveList, b);
+    if (mv != QUIET) {
+        getEnPassant<c>(moveList, b, king);
     }
-}
 
-template<Color c>
-inline void getLegalMoves(vector<Move> &moveList, Board& b) {
-    c == nWhite ? getAllMoves<nWhite>(moveList, b) :
-        getAllMoves<nBlack>(moveList, b);
-    vector<Move>::iterator it = moveList.begin();
-    while (it != moveList.end()) {
-        if (!b.isLegal(*it)) {
-            it = moveList.erase(it);
-        } else {
-            it++;
-        }
+    getPieceMoves<c, nKnight, mv>(moveList, b, king);
+    getPieceMoves<c, nBishop, mv>(moveList, b, king);
+    getPieceMoves<c, nRook, mv>(moveList, b, king);
+    getPieceMoves<c, nQueen, mv>(moveList, b, king);
+
+    if (mv != CAPTURES && !king.checkers) {
+        getCastleMoves<c>(moveList, b, true);
+        getCastleMoves<c>(moveList, b, false);
     }
 }
 
@@ -0,0 +1,150 @@
+#include "movepick.hpp"
+
+// Constructs a picker for a node of the main search
+MovePicker::MovePicker(Board& b, Move ttMove, const Move* killers) {
+    this->b = &b;
+    this->quiescence = false;
+    this->stage = STAGE_TT;
+    this->index = 0;
+    this->ttMove = (isValid(ttMove) ? ttMove : Move());
+    this->killers[0] = killers[0];
+    this->killers[1] = (killers[1] == killers[0] ? Move() : killers[1]);
+}
+
+
+// Constructs a picker handing out captures for quiescence search
+MovePicker::MovePicker(Board& b, Move ttMove) {
+    this->b = &b;
+    this->quiescence = true;
+    this->stage = STAGE_TT;
+    this->index = 0;
+    this->ttMove = ((ttMove.isCapture() || ttMove.isPromotion()) &&
+            isValid(ttMove) ? ttMove : Move());
+    this->killers[0] = Move();
+    this->killers[1] = Move();
+}
+
+
+// Points the picker at another copy of the same position
+void MovePicker::setBoard(Board& b) {
+    this->b = &b;
+}
+
+
+// Returns whether a move taken from elsewhere is legal in this position
+bool MovePicker::isValid(Move m) const {
+    return m != Move() && b->isPseudoLegal(m) && b->isLegal(m);
+}
+
+
+// Returns the ordering score of a capture or promotion: the most valuable
+// victim first, then the least valuable attacker
+int MovePicker::captureScore(Move m) const {
+    int score = -(int)b->getPiece(m.getFrom());
+    if (m.getFlags() == 5) {
+        score += PieceVals[nPawn];
+    } else if (m.isCapture()) {
+        score += PieceVals[b->getPiece(m.getTo())];
+    }
+    if (m.isPromotion()) {
+        score += PieceVals[1 + (m.getFlags() & 3)] - PieceVals[nPawn];
+    }
+    return score;
+}
+
+
+// Returns whether a capture or promotion is expected to lose material: an
+// underpromotion, or a capture that loses the exchange on its square
+bool MovePicker::isBadCapture(Move m) const {
+    if (m.isPromotion() && (m.getFlags() & 3) != 3) {
+        return true;
+    }
+    return !b->seeGe(m, 0);
+}
+
+
+// Returns the next move, or Move() when there are none left. Each stage
+// falls through to the next one once it has no moves left.
+Move MovePicker::next() {
+    switch (stage) {
+    case STAGE_TT:
+        stage = STAGE_INIT_CAPTURES;
+        if (ttMove != Move()) {
+            return ttMove;
+        }
+        // fall through
+    case STAGE_INIT_CAPTURES: {
+        MoveList moves;
+        b->getToMove() == nWhite ? getLegalMoves<nWhite, CAPTURES>(moves, *b) :
+            getLegalMoves<nBlack, CAPTURES>(moves, *b);
+        for (Move m : moves) {
+            captures.push_back(MoveData(captureScore(m), m));
+        }
+        index = 0;
+        stage = STAGE_GOOD_CAPTURES;
+    }
+        // fall through
+    case STAGE_GOOD_CAPTURES:
+        while (index < captures.size()) {
+            // selection sort, one move at a time
+            unsigned int best = index;
+            for (unsigned int i = index + 1; i < captures.size(); i++) {
+                if (captures[i].score > captures[best].score) {
+                    best = i;
+                }
+            }
+            std::swap(captures[index], captures[best]);
+            Move m = captures[index++].move;
+            if (m == ttMove) {
+                continue;
+            }
+            if (isBadCapture(m)) {
+                badCaptures.push_back(m);
+                continue;
+            }
+            return m;
+        }
+        index = 0;
+        if (quiescence) { // losing captures are pruned
+            stage = STAGE_DONE;
+            return Move();
+        }
+        stage = STAGE_KILLERS;
+        // fall through
+    case STAGE_KILLERS:
+        while (index < 2) {
+            Move m = killers[index++];
+            if (m != ttMove && !m.isCapture() && !m.isPromotion() &&
+                    isValid(m)) {
+                return m;
+            }
+            killers[index - 1] = Move();
+        }
+        stage = STAGE_INIT_QUIETS;
+        // fall through
+    case STAGE_INIT_QUIETS:
+        b->getToMove() == nWhite ? getLegalMoves<nWhite, QUIET>(quiets, *b) :
+            getLegalMoves<nBlack, QUIET>(quiets, *b);
+        index = 0;
+        stage = STAGE_QUIETS;
+        // fall through
+    case STAGE_QUIETS:
+        while (index < quiets.size()) {
+            Move m = quiets[index++];
+            if (m != ttMove && m != killers[0] && m != killers[1]) {
+                return m;
+            }
+        }
+        index = 0;
+        stage = STAGE_BAD_CAPTURES;
+        // fall through
+    case STAGE_BAD_CAPTURES:
+        if (index < badCaptures.size()) {
+            return badCaptures[index++];
+        }
+        stage = STAGE_DONE;
+        // fall through
+    default:
+        return Move();
+    }
+}
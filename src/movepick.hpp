@@ -0,0 +1,82 @@
+#ifndef MOVEPICK_HPP
+#define MOVEPICK_HPP
+
+#include "board.hpp"
+#include "movegen.hpp"
+
+struct MoveData {
+    Move move;
+    int score;
+
+    MoveData(int score, Move m) {
+        this->move = m;
+        this->score = score;
+    }
+
+    MoveData() {
+        this->move = Move();
+        this->score = 0;
+    }
+};
+
+typedef StackList<MoveData> ScoredMoveList;
+
+// Stages a move picker passes through, in order
+enum PickStage {
+    STAGE_TT,
+    STAGE_INIT_CAPTURES,
+    STAGE_GOOD_CAPTURES,
+    STAGE_KILLERS,
+    STAGE_INIT_QUIETS,
+    STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_DONE
+};
+
+// Hands out the legal moves of a position one at a time, best first. Moves
+// are generated lazily in stages, so a node that fails high on the hash move
+// or a capture never generates its quiet moves:
+// 1. the hash move, checked for legality instead of generated
+// 2. winning and equal captures and promotions, selected best first
+// 3. the killer moves, checked for legality
+// 4. the remaining quiet moves
+// 5. losing captures and underpromotions
+// In quiescence search only the hash move, if it is a capture, and the
+// captures that do not lose material are handed out.
+class MovePicker {
+    Board* b;
+    Move ttMove;
+    Move killers[2];
+    // whether quiet moves and killers are skipped
+    bool quiescence;
+    int stage;
+    ScoredMoveList captures;
+    MoveList quiets;
+    // captures found to lose material, handed out last
+    MoveList badCaptures;
+    unsigned int index;
+
+    // Returns the ordering score of a capture or promotion
+    int captureScore(Move m) const;
+
+    // Returns whether a capture or promotion is expected to lose material
+    bool isBadCapture(Move m) const;
+
+    // Returns whether a move taken from elsewhere is legal in this position
+    bool isValid(Move m) const;
+public:
+    // Constructs a picker for a node of the main search
+    MovePicker(Board& b, Move ttMove, const Move* killers);
+
+    // Constructs a picker handing out captures for quiescence search
+    MovePicker(Board& b, Move ttMove);
+
+    // Returns the next move, or Move() when there are none left
+    Move next();
+
+    // Points the picker at another copy of the same position, so the board
+    // it was built on may change while moves are still being handed out
+    void setBoard(Board& b);
+};
+
+#endif
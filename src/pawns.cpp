@@ -0,0 +1,75 @@
+#include "pawns.hpp"
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+
+PawnTable pawnTable;
+
+// Allocates the table aligned to a cache line, so no entry straddles two
+PawnTable::PawnTable() {
+    memory = malloc(PAWN_TABLE_SIZE * sizeof(PawnEntry) + 63);
+    if (!memory) {
+        std::cerr << "Failed to allocate the pawn table" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    table = (PawnEntry*)(((uintptr_t)memory + 63) & ~(uintptr_t)63);
+    clear();
+}
+
+
+PawnTable::~PawnTable() {
+    free(memory);
+}
+
+
+// Empties every entry in the table. An empty entry has an all zero key and
+// data, which only a position without pawns can match, and there the pawn
+// terms are the same for both colors and cancel out anyway.
+void PawnTable::clear() {
+    for (size_t i = 0; i < PAWN_TABLE_SIZE; i++) {
+        table[i].keyXor.store(0, std::memory_order_relaxed);
+        table[i].counts.store(0, std::memory_order_relaxed);
+        for (int c = nWhite; c <= nBlack; c++) {
+            table[i].passed[c].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+// Looks up the given pawn key, copying the entry and returning true on a hit
+bool PawnTable::probe(unsigned long long key, PawnInfo& info) const {
+    const PawnEntry* entry = &table[key & (PAWN_TABLE_SIZE - 1)];
+    unsigned long long counts = entry->counts.load(std::memory_order_relaxed);
+    unsigned long long check = entry->keyXor.load(std::memory_order_relaxed) ^
+        counts;
+    for (int c = nWhite; c <= nBlack; c++) {
+        info.passed[c] = entry->passed[c].load(std::memory_order_relaxed);
+        check ^= info.passed[c];
+    }
+    if (check != key) {
+        return false;
+    }
+    for (int c = nWhite; c <= nBlack; c++) {
+        info.isolated[c] = (signed char)(counts >> (24 * c));
+        info.doubled[c] = (signed char)(counts >> (24 * c + 8));
+        info.backward[c] = (signed char)(counts >> (24 * c + 16));
+    }
+    return true;
+}
+
+
+// Stores the pawn structure evaluation of the given pawn key
+void PawnTable::store(unsigned long long key, const PawnInfo& info) {
+    PawnEntry* entry = &table[key & (PAWN_TABLE_SIZE - 1)];
+    unsigned long long counts = 0;
+    unsigned long long keyXor = key;
+    for (int c = nWhite; c <= nBlack; c++) {
+        counts |= (unsigned long long)(unsigned char)info.isolated[c] << (24 * c);
+        counts |= (unsigned long long)(unsigned char)info.doubled[c] << (24 * c + 8);
+        counts |= (unsigned long long)(unsigned char)info.backward[c] << (24 * c + 16);
+        entry->passed[c].store(info.passed[c], std::memory_order_relaxed);
+        keyXor ^= info.passed[c];
+    }
+    entry->counts.store(counts, std::memory_order_relaxed);
+    entry->keyXor.store(keyXor ^ counts, std::memory_order_relaxed);
+}
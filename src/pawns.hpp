@@ -0,0 +1,57 @@
+#ifndef PAWNS_HPP
+#define PAWNS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include "bitboard.hpp"
+
+// Holds the parts of the evaluation that depend only on the pawns of both
+// colors, indexed by color
+struct PawnInfo {
+    int isolated[2];
+    int doubled[2];
+    int backward[2];
+    // pawns that are passed or are candidate passers
+    Bitboard passed[2];
+};
+
+// Holds a pawn table entry as it is stored. The key is stored XORed with
+// every data word, so an entry torn by a concurrent write fails the key
+// check and threads can share the table without locking. Two entries fit in
+// a cache line.
+struct alignas(32) PawnEntry {
+    std::atomic<unsigned long long> keyXor;
+    // the isolated, doubled and backward counts, one byte each per color
+    std::atomic<unsigned long long> counts;
+    std::atomic<unsigned long long> passed[2];
+};
+
+// Number of entries in the pawn table, a power of two
+const size_t PAWN_TABLE_SIZE = 1 << 14;
+
+// Caches pawn structure evaluations keyed by the pawn zobrist key. Pawn
+// structures change rarely within a search, so nearly every lookup hits.
+class PawnTable {
+    PawnEntry* table;
+    // Holds the unaligned allocation backing the table
+    void* memory;
+public:
+    PawnTable();
+
+    ~PawnTable();
+
+    // Empties every entry in the table
+    void clear();
+
+    // Looks up the given pawn key, copying the entry and returning true on a
+    // hit
+    bool probe(unsigned long long key, PawnInfo& info) const;
+
+    // Stores the pawn structure evaluation of the given pawn key
+    void store(unsigned long long key, const PawnInfo& info);
+};
+
+// The pawn table shared by every search
+extern PawnTable pawnTable;
+
+#endif
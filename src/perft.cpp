@@ -0,0 +1,216 @@
+#include "perft.hpp"
+#include "movegen.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+PerftTable::PerftTable() {
+    table = nullptr;
+    memory = nullptr;
+    bucketCount = 0;
+    sizeMb = 0;
+}
+
+
+PerftTable::~PerftTable() {
+    free(memory);
+}
+
+
+// Reallocates the table to use at most the given number of megabytes,
+// keeping the contents if the size is unchanged. A size of zero disables the
+// table.
+void PerftTable::resize(size_t mb) {
+    if (mb == sizeMb) {
+        return;
+    }
+    free(memory);
+    memory = nullptr;
+    table = nullptr;
+    bucketCount = 0;
+    sizeMb = mb;
+    if (mb == 0) {
+        return;
+    }
+
+    size_t buckets = (mb * 1024 * 1024) / sizeof(PerftBucket);
+    size_t newCount = 1;
+    while (newCount * 2 <= buckets) {
+        newCount *= 2;
+    }
+
+    memory = malloc(newCount * sizeof(PerftBucket) + 63);
+    if (!memory) {
+        std::cerr << "Failed to allocate " << mb << "MB for the perft table" <<
+            std::endl;
+        exit(EXIT_FAILURE);
+    }
+    table = (PerftBucket*)(((uintptr_t)memory + 63) & ~(uintptr_t)63);
+    bucketCount = newCount;
+    clear();
+}
+
+
+// Empties every entry in the table
+void PerftTable::clear() {
+    for (size_t i = 0; i < bucketCount; i++) {
+        for (int j = 0; j < 2; j++) {
+            table[i].entries[j].data.store(0, std::memory_order_relaxed);
+            table[i].entries[j].keyXor.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+// Looks up the leaf count of the given key and depth, returning true on a
+// hit. An entry torn by a concurrent write fails the key check.
+bool PerftTable::probe(unsigned long long key, int depth,
+        unsigned long long& nodes) const {
+    if (bucketCount == 0) {
+        return false;
+    }
+    PerftBucket* bucket = &table[key & (bucketCount - 1)];
+    for (int i = 0; i < 2; i++) {
+        unsigned long long data =
+            bucket->entries[i].data.load(std::memory_order_relaxed);
+        unsigned long long keyXor =
+            bucket->entries[i].keyXor.load(std::memory_order_relaxed);
+        if ((keyXor ^ data) == key && (int)(data & 0xff) == depth) {
+            nodes = data >> 8;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Stores the leaf count of the given key and depth. The first entry keeps
+// the deepest result seen, and anything shallower goes to the second.
+void PerftTable::store(unsigned long long key, int depth,
+        unsigned long long nodes) {
+    if (bucketCount == 0) {
+        return;
+    }
+    PerftBucket* bucket = &table[key & (bucketCount - 1)];
+    PerftEntry* entry = &bucket->entries[0];
+    if ((int)(entry->data.load(std::memory_order_relaxed) & 0xff) > depth) {
+        entry = &bucket->entries[1];
+    }
+    unsigned long long data = (nodes << 8) | (unsigned long long)depth;
+    entry->data.store(data, std::memory_order_relaxed);
+    entry->keyXor.store(key ^ data, std::memory_order_relaxed);
+}
+
+
+// Returns the number of leaf nodes of the legal move tree of the given depth.
+// Moves at the last ply are counted without being made.
+unsigned long long perft(Board& b, int depth) {
+    MoveList moves;
+    b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) :
+        getLegalMoves<nBlack>(moves, b);
+
+    if (depth <= 1) {
+        return depth == 1 ? moves.size() : 1;
+    }
+
+    unsigned long long nodes = 0;
+    for (Move m : moves) {
+        b.makeMove(m);
+        nodes += perft(b, depth - 1);
+        b.unmakeMove(m);
+    }
+    return nodes;
+}
+
+
+// Returns the number of leaf nodes of the legal move tree of the given depth,
+// reusing the counts of transposed subtrees from the table
+unsigned long long perftHashed(Board& b, int depth, PerftTable& table) {
+    if (depth <= 1) {
+        return perft(b, depth);
+    }
+
+    unsigned long long nodes = 0;
+    if (table.probe(b.getZobrist(), depth, nodes)) {
+        return nodes;
+    }
+
+    MoveList moves;
+    b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) :
+        getLegalMoves<nBlack>(moves, b);
+    for (Move m : moves) {
+        b.makeMove(m);
+        nodes += perftHashed(b, depth - 1, table);
+        b.unmakeMove(m);
+    }
+
+    table.store(b.getZobrist(), depth, nodes);
+    return nodes;
+}
+
+
+// Counts the subtrees of root moves taken from the shared index until none
+// are left, searching a private copy of the board
+static void perftWorker(Board board, const MoveList* moves, int depth,
+        PerftTable* table, std::atomic<unsigned int>* next,
+        std::vector<unsigned long long>* counts) {
+    unsigned int index;
+    while ((index = (*next)++) < moves->size()) {
+        Move m = (*moves)[index];
+        board.makeMove(m);
+        (*counts)[index] = perftHashed(board, depth - 1, *table);
+        board.unmakeMove(m);
+    }
+}
+
+
+// Runs perft to the given depth, printing the count below each root move
+// when divide is set, followed by the total, time and speed. The root moves
+// are shared between the given number of threads, each searching its own
+// copy of the board.
+void runPerft(Board& b, int depth, bool divide, int threads,
+        PerftTable& table) {
+    auto start = chrono::high_resolution_clock::now();
+    unsigned long long nodes = 0;
+
+    if (depth >= 1) {
+        MoveList moves;
+        b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) :
+            getLegalMoves<nBlack>(moves, b);
+
+        std::vector<unsigned long long> counts(moves.size(), 0);
+        std::atomic<unsigned int> next(0);
+        int helpers = std::max(0, std::min(threads, (int)moves.size()) - 1);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < helpers; i++) {
+            workers.push_back(std::thread(perftWorker, b, &moves, depth,
+                        &table, &next, &counts));
+        }
+        perftWorker(b, &moves, depth, &table, &next, &counts);
+        for (std::thread& th : workers) {
+            th.join();
+        }
+
+        for (unsigned int i = 0; i < moves.size(); i++) {
+            if (divide) {
+                cout << moves[i].toStr() << ": " << counts[i] << endl;
+            }
+            nodes += counts[i];
+        }
+        if (divide) {
+            cout << endl;
+        }
+    } else {
+        nodes = perft(b, depth);
+    }
+
+    auto dur = chrono::high_resolution_clock::now() - start;
+    long long ms = chrono::duration_cast<chrono::milliseconds>(dur).count();
+    cout << "Nodes searched: " << nodes << endl;
+    cout << "Time: " << ms << " ms" << endl;
+    if (ms != 0) {
+        cout << "Mnps: " << nodes / (ms * 1000.0) << endl;
+    }
+}
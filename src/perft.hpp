@@ -0,0 +1,71 @@
+#ifndef PERFT_HPP
+#define PERFT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include "board.hpp"
+
+// Holds a perft result as it is stored in the table. The leaf count and
+// depth are packed into one data word, and the key is stored XORed with it,
+// so threads can share the table without locking.
+struct PerftEntry {
+    std::atomic<unsigned long long> keyXor;
+    std::atomic<unsigned long long> data;
+};
+
+// Holds a depth-preferred and an always-replace entry
+struct alignas(32) PerftBucket {
+    PerftEntry entries[2];
+};
+
+// Default size of the perft table in megabytes
+const int DEFAULT_PERFT_HASH_MB = 64;
+
+// Caches the leaf counts of positions reached during perft, keyed by the
+// zobrist key and the remaining depth
+class PerftTable {
+    // Holds the buckets, aligned to the start of a cache line
+    PerftBucket* table;
+    // Holds the unaligned allocation backing the table
+    void* memory;
+    // Number of buckets, always a power of two, or zero when disabled
+    size_t bucketCount;
+    // Size the table was last allocated with, in megabytes
+    size_t sizeMb;
+public:
+    // Constructs an empty table, which never hits until it is resized
+    PerftTable();
+
+    ~PerftTable();
+
+    // Reallocates the table to use at most the given number of megabytes,
+    // keeping the contents if the size is unchanged
+    void resize(size_t mb);
+
+    // Empties every entry in the table
+    void clear();
+
+    // Looks up the leaf count of the given key and depth, returning true on
+    // a hit
+    bool probe(unsigned long long key, int depth,
+            unsigned long long& nodes) const;
+
+    // Stores the leaf count of the given key and depth
+    void store(unsigned long long key, int depth, unsigned long long nodes);
+};
+
+// Returns the number of leaf nodes of the legal move tree of the given depth
+unsigned long long perft(Board& b, int depth);
+
+// Returns the number of leaf nodes of the legal move tree of the given depth,
+// reusing the counts of transposed subtrees from the table
+unsigned long long perftHashed(Board& b, int depth, PerftTable& table);
+
+// Runs perft to the given depth, printing the count below each root move
+// when divide is set, followed by the total, time and speed. The root moves
+// are shared between the given number of threads, each searching its own
+// copy of the board.
+void runPerft(Board& b, int depth, bool divide, int threads,
+        PerftTable& table);
+
+#endif
@@ -0,0 +1,143 @@
+#include "pext.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+U64* pextBishopAttacks[64];
+U64* pextRookAttacks[64];
+
+// Holds the attacks of every square and occupancy, 5248 bishop and 102400
+// rook entries
+static U64 bishopTable[5248];
+static U64 rookTable[102400];
+
+static bool pextReady = false;
+
+
+// Returns the attacks of a slider moving along the given directions from a
+// square, stopping at the first occupied square in each direction
+static U64 slowAttacks(int square, U64 occupancy, const int deltas[4][2]) {
+    U64 attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        int rank = square / 8 + deltas[d][0];
+        int file = square % 8 + deltas[d][1];
+        while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+            U64 bit = 1ULL << (8 * rank + file);
+            attacks |= bit;
+            if (occupancy & bit) {
+                break;
+            }
+            rank += deltas[d][0];
+            file += deltas[d][1];
+        }
+    }
+    return attacks;
+}
+
+
+// Fills the attacks of one piece type for every square, enumerating the
+// subsets of each mask in increasing order, which is the order of their
+// PEXT indices
+static void fillTable(U64* table, U64* pointers[64], const U64 masks[64],
+        const int deltas[4][2]) {
+    for (int sq = 0; sq < 64; sq++) {
+        pointers[sq] = table;
+        U64 subset = 0;
+        do {
+            *table++ = slowAttacks(sq, subset, deltas);
+            subset = (subset - masks[sq]) & masks[sq];
+        } while (subset);
+    }
+}
+
+
+// Fills the PEXT attack tables
+void initPext() {
+    static const int bishopDeltas[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+    static const int rookDeltas[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    if (pextReady) {
+        return;
+    }
+    fillTable(bishopTable, pextBishopAttacks, magicmoves_b_mask, bishopDeltas);
+    fillTable(rookTable, pextRookAttacks, magicmoves_r_mask, rookDeltas);
+    pextReady = true;
+}
+
+
+// Looks up the attacks of every sample with the magics, returning the XOR of
+// them so the lookups cannot be optimized away
+static U64 lookupMagic(const vector<int>& squares, const vector<U64>& occupied) {
+    U64 check = 0;
+    for (size_t i = 0; i < squares.size(); i++) {
+        check ^= Bmagic(squares[i], occupied[i]);
+        check ^= Rmagic(squares[i], occupied[i]);
+    }
+    return check;
+}
+
+
+#if defined(__GNUC__) && defined(__x86_64__)
+// Looks up the attacks of every sample with PEXT. Compiled for BMI2 even in
+// builds without it, and only called when the CPU has it.
+__attribute__((target("bmi2")))
+static U64 lookupPext(const vector<int>& squares, const vector<U64>& occupied) {
+    U64 check = 0;
+    for (size_t i = 0; i < squares.size(); i++) {
+        int sq = squares[i];
+        check ^= pextBishopAttacks[sq][_pext_u64(occupied[i],
+                magicmoves_b_mask[sq])];
+        check ^= pextRookAttacks[sq][_pext_u64(occupied[i],
+                magicmoves_r_mask[sq])];
+    }
+    return check;
+}
+#endif
+
+
+// Times one backend and prints its lookups per second
+static U64 timeLookups(const char* name, U64 (*lookup)(const vector<int>&,
+            const vector<U64>&), const vector<int>& squares, const
+        vector<U64>& occupied) {
+    auto start = chrono::high_resolution_clock::now();
+    U64 check = lookup(squares, occupied);
+    auto dur = chrono::high_resolution_clock::now() - start;
+    double seconds = chrono::duration<double>(dur).count();
+    unsigned long long lookups = 2ULL * squares.size();
+    cout << name << ": " << lookups << " lookups in " << (long)(seconds *
+            1000) << " ms, " << (unsigned long long)(lookups / seconds) <<
+        " lookups/s" << endl;
+    return check;
+}
+
+
+// Times bishop and rook lookups on random occupancies with both backends
+void benchSliders(int count) {
+    mt19937_64 eng(1);
+    vector<int> squares(count);
+    vector<U64> occupied(count);
+    for (int i = 0; i < count; i++) {
+        squares[i] = eng() & 63;
+        occupied[i] = eng() & eng(); // a quarter of the squares, like a game
+    }
+
+    U64 magic = timeLookups("magic", lookupMagic, squares, occupied);
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("bmi2")) {
+        initPext();
+        U64 pext = timeLookups("pext", lookupPext, squares, occupied);
+        if (pext != magic) {
+            cout << "pext and magic attacks differ" << endl;
+        }
+        return;
+    }
+#endif
+    (void)magic;
+    cout << "pext: not supported by this CPU" << endl;
+}
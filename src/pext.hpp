@@ -0,0 +1,44 @@
+#ifndef PEXT_HPP
+#define PEXT_HPP
+
+#include "MagicMoves.hpp"
+
+// Sliding attacks indexed with the BMI2 PEXT instruction, an alternative to
+// the magic multiply. PEXT gathers the occupancy bits under a square's mask
+// into a dense index, so no magic numbers or shifts are needed. Builds with
+// USE_PEXT and BMI2 look up every slider attack here; PEXT is microcoded and
+// slow on AMD CPUs before Zen 3, where the magics are faster.
+#if defined(USE_PEXT)
+#if !defined(__BMI2__)
+#error "USE_PEXT needs BMI2, build with -mbmi2"
+#endif
+#include <immintrin.h>
+#endif
+
+// Holds a pointer into the bishop and rook attack tables for each square
+extern U64* pextBishopAttacks[64];
+extern U64* pextRookAttacks[64];
+
+// Fills the PEXT attack tables. They share the relevant occupancy masks of
+// the magic tables.
+void initPext();
+
+#if defined(USE_PEXT)
+// Returns the bishop attacks from a square given the occupied squares
+inline U64 Bpext(int square, U64 occupancy) {
+    return pextBishopAttacks[square][_pext_u64(occupancy,
+            magicmoves_b_mask[square])];
+}
+
+// Returns the rook attacks from a square given the occupied squares
+inline U64 Rpext(int square, U64 occupancy) {
+    return pextRookAttacks[square][_pext_u64(occupancy,
+            magicmoves_r_mask[square])];
+}
+#endif
+
+// Times bishop and rook lookups on random occupancies with the magics and,
+// when the CPU has BMI2, with PEXT, and prints the lookups per second of each
+void benchSliders(int count);
+
+#endif
@@ -5,35 +5,139 @@ const int MAX_VALUE = 50000;
 
 Search::Search(SearchInfo* info) {
     this->info = info;
+    rootDepth = 0;
+    nodes = 0;
+    bestMoveNodes = 0;
+    evalProbes = 0;
+    evalHits = 0;
+    pool = nullptr;
+    splitPoint = nullptr;
+}
+
+
+// Returns the static evaluation of the board, looking it up in the evaluation
+// cache first. Only this object's thread writes the counters.
+int Search::evaluate(Board &b) {
+    int eval;
+    evalProbes.store(evalProbes.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+    if (evalCache.probe(b.getZobrist(), eval)) {
+        evalHits.store(evalHits.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        return eval;
+    }
+    eval = b.boardScore();
+    evalCache.store(b.getZobrist(), eval);
+    return eval;
+}
+
+
+// Returns whether the search was stopped or a split point this thread is
+// working for has failed high
+bool Search::aborted() const {
+    if (info->stopped) {
+        return true;
+    }
+    for (SplitPoint* sp = splitPoint; sp; sp = sp->parent) {
+        if (sp->cutoff) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Searches a move after the first one at its node with a null window,
+// reducing late quiet moves, and re-searches it if it raises alpha
+int Search::searchLateMove(Board &b, Move m, unsigned int loc, int depth, int
+        alpha, int beta) {
+    int searchVal;
+    b.makeMove(m);
+    if (loc >= 4 && depth >= 3 && !m.isCapture() && !b.inCheck()) {
+        searchVal = -negamax(b, depth - 2, -alpha - 1, -alpha, false, true);
+    } else {
+        searchVal = -negamax(b, depth - 1, -alpha - 1, -alpha, false, true);
+    }
+    if (alpha < searchVal && searchVal < beta) {
+        searchVal = -negamax(b, depth - 1, -beta, -searchVal, false, true);
+    }
+    b.unmakeMove(m);
+    return searchVal;
+}
+
+
+// Searches the remaining moves of a split point, sharing its bounds with the
+// other threads working on it
+void Search::searchSplit(Board &b, SplitPoint* sp) {
+    while (!aborted()) {
+        Move m;
+        unsigned int loc;
+        int alpha;
+        {
+            std::lock_guard<std::mutex> guard(sp->lock);
+            m = sp->picker->next();
+            if (m == Move()) {
+                sp->finished = true;
+                break;
+            }
+            loc = ++sp->moveCount;
+            alpha = sp->alpha;
+        }
+        if (alpha >= sp->beta) {
+            break;
+        }
+        int searchVal = searchLateMove(b, m, loc, sp->depth, alpha, sp->beta);
+        if (aborted()) {
+            break;
+        }
+
+        std::lock_guard<std::mutex> guard(sp->lock);
+        if (searchVal > sp->alpha) {
+            sp->alpha = searchVal;
+            sp->bestMove = m;
+            if (searchVal >= sp->beta) {
+                sp->cutoff = true;
+            }
+        }
+    }
+}
+
+
+// Joins a split point published by another thread as a helper
+void Search::helpSplit(Board &b, SplitPoint* sp) {
+    SplitPoint* previous = splitPoint;
+    splitPoint = sp;
+    rootDepth = sp->ply + sp->depth;
+    searchSplit(b, sp);
+    splitPoint = previous;
 }
 
 // Alpha beta search algorithm. Takes a board and a search depth, and finds the board score
 // using an implementation of alpha beta and negamax.
 int Search::negamax(Board &b, int depth, int alpha, int beta, bool pv, bool
         nullOkay) {
-    info->nodes++;
+    // a stopped search returns at once, so a node limit is met exactly
+    if (info->stopped) {
+        return alpha;
+    }
+    countNode();
 
     if (b.isRep() || b.getFiftyCount() > 99) { // one time repetition, fifty moves
         return 0;
     }
 
-    int ply = info->depth - depth;
-
-    int hashKey = b.getZobrist() % TABLE_SIZE;
-    HashEntry oldEntry = b.getTransTable(hashKey);
-    HashEntry entry = b.getTransTable(hashKey);
+    int ply = rootDepth - depth;
 
-    if (entry.nodeType != HASH_NULL && entry.depth >= depth) { // valid node
-        if (entry.zobrist == b.getZobrist()) {
-            if (entry.nodeType == HASH_EXACT) {
-                return entry.score;
-            } else if (entry.zobrist == HASH_ALPHA) {
-                alpha = max(alpha, entry.score);
-            } else {
-                beta = max(beta, entry.score);
-            }
+    HashEntry entry;
+    if (TT.probe(b.getZobrist(), entry) && entry.depth >= depth) { // valid node
+        if (entry.nodeType == HASH_EXACT) {
+            return entry.score;
+        } else if (entry.nodeType == HASH_ALPHA) {
+            alpha = max(alpha, entry.score);
+        } else {
+            beta = min(beta, entry.score);
         }
-        if (alpha > beta) {
+        if (alpha >= beta) {
             return entry.score;
         }
     }
@@ -45,25 +149,14 @@ int Search::negamax(Board &b, int depth, int alpha, int beta, bool pv, bool
         return score;
     }
 
-    std::vector<Move> moves;
-    std::vector<MoveData> moveList;
-    b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) : getLegalMoves<nBlack>(moves, b);
-
-    if (moves.empty()) { 
-        if (b.inCheck()) {
-            return -MATE_VALUE - depth;
-       } else {
-            return 0;
-       }
+    // the static evaluation, taken from the hash entry when it holds one
+    bool inCheck = b.inCheck();
+    int staticEval = EVAL_NONE;
+    if (!inCheck) {
+        staticEval = (entry.eval != EVAL_NONE ? entry.eval : evaluate(b));
     }
 
-    Search::orderMoves(b, moves, moveList, ply);
-
-    Move currBest;
-
-    unsigned int loc = 0;
-
-    if (!pv && !b.inCheck() && nullOkay && depth > 3) {
+    if (!pv && !inCheck && nullOkay && depth > 3 && staticEval >= beta) {
         if (b.materialCount(nWhite, false) + b.materialCount(nBlack, false) > 1800) {
             b.makeNullMove(); 
             int searchVal = -negamax(b, depth - 3, -beta, -beta + 1, false, false);
@@ -75,65 +168,76 @@ int Search::negamax(Board &b, int depth, int alpha, int beta, bool pv, bool
         }
     }
 
-    for (MoveData mv : moveList) {
+    MovePicker picker(b, entry.move, killerMoves[ply]);
+    Move currBest;
+    Move m;
+    unsigned int loc = 0;
+
+    while ((m = picker.next()) != Move()) {
         loc++;
-        if (2 * loc > moveList.size() && info->stopped) {
+        if (loc > 1 && aborted()) {
             return alpha;
         }
         int searchVal;
-
-        Move m = mv.move;
-        if (b.isLegal(m)) {
+        if (loc > 1) {
+            searchVal = searchLateMove(b, m, loc, depth, alpha, beta);
+        } else {
             b.makeMove(m);
-            if (loc > 1) {
-                if (loc >= 4 && depth >= 3 && !m.isCapture() &&
-                        !b.inCheck()) {
-                    searchVal = -negamax(b, depth - 2, -alpha - 1, -alpha,
-                            false, true);
-                } else {
-                    searchVal = -negamax(b, depth - 1, -alpha - 1, -alpha,
-                            false, true);
-                }
-                if (alpha < searchVal && searchVal < beta) {
-                    searchVal = -negamax(b, depth - 1, -beta, -searchVal, false, true);
-                }
-            } else {
-                searchVal = -negamax(b, depth - 1, -beta, -alpha, true, true);
-            }
+            searchVal = -negamax(b, depth - 1, -beta, -alpha, true, true);
             b.unmakeMove(m);
-            if (searchVal > alpha) {
-                currBest = m;
+        }
+        if (searchVal > alpha) {
+            currBest = m;
+        }
+        alpha = max(searchVal, alpha);
+
+        if (alpha >= beta) {
+            storeKiller(m, ply);
+            break;
+        }
+
+        // Young Brothers Wait: once a move has been searched without a
+        // cutoff, the remaining ones may be shared with idle threads
+        if (pool && depth >= SPLIT_DEPTH && pool->hasIdle()) {
+            SplitPoint sp(b, splitPoint, &picker, loc, depth, ply, alpha,
+                    beta, currBest);
+            SplitPoint* previous = splitPoint;
+            splitPoint = &sp;
+            pool->publish(&sp);
+            searchSplit(b, &sp);
+            pool->retract(&sp);
+            while (sp.workers > 0) {
+                std::this_thread::yield();
             }
-            alpha = max(searchVal, alpha);
+            splitPoint = previous;
 
+            alpha = sp.alpha;
+            currBest = sp.bestMove;
             if (alpha >= beta) {
-                b.killerMoves[ply][1] = b.killerMoves[ply][0];
-                b.killerMoves[ply][0] = m;
-                break;
+                storeKiller(currBest, ply);
             }
+            break;
         }
     }
 
-    entry.score = alpha;
-    entry.depth = depth;
-    entry.move = currBest;
+    if (loc == 0) { // checkmate or stalemate
+        return inCheck ? -MATE_VALUE - depth : 0;
+    }
+
+    // results of an aborted search are unreliable, keep them out of the table
+    if (aborted()) {
+        return alpha;
+    }
 
+    HashType nodeType;
     if (alpha <= oldAlpha) {
-        entry.nodeType = HASH_BETA;
+        nodeType = HASH_BETA;
     } else if (alpha >= beta) {
-        entry.nodeType = HASH_ALPHA;
+        nodeType = HASH_ALPHA;
     } else {
-        entry.nodeType = HASH_EXACT;
-    }
-
-    if (oldEntry.nodeType != HASH_EXACT && entry.nodeType == HASH_EXACT) {
-        b.setTransTable(hashKey, entry);
-    }
-    if (!(oldEntry.nodeType == HASH_EXACT && entry.nodeType != HASH_EXACT)) {
-        if (entry.depth >= oldEntry.depth) {
-            b.setTransTable(hashKey, entry);
-        }
+        nodeType = HASH_EXACT;
     }
+    TT.store(b.getZobrist(), depth, alpha, nodeType, currBest, staticEval);
 
     return alpha;
 }
@@ -143,25 +247,22 @@ int Search::negamax(Board &b, int depth, int alpha, int beta, bool pv, bool
 // using an implementation of alpha beta and negamax. Updates the best move in
 // the search object.
 int Search::negamaxRoot(Board &b, int depth, int alpha, int beta) {
-    info->nodes++;
-    int ply = info->depth - depth;
-
-    int hashKey = b.getZobrist() % TABLE_SIZE;
-    HashEntry oldEntry = b.getTransTable(hashKey);
-    HashEntry entry = b.getTransTable(hashKey);
-
-    if (entry.nodeType != HASH_NULL && entry.depth >= depth) { // valid node
-        if (entry.zobrist == b.getZobrist()) {
-            if (entry.nodeType == HASH_EXACT) {
-                bestMove = entry.move;
-                return entry.score;
-            } else if (entry.zobrist == HASH_ALPHA) {
-                alpha = max(alpha, entry.score);
-            } else {
-                beta = max(beta, entry.score);
-            }
+    countNode();
+    rootDepth = depth;
+    bestMoveNodes = 0;
+    int ply = 0;
+
+    HashEntry entry;
+    if (TT.probe(b.getZobrist(), entry) && entry.depth >= depth) { // valid node
+        if (entry.nodeType == HASH_EXACT) {
+            bestMove = entry.move;
+            return entry.score;
+        } else if (entry.nodeType == HASH_ALPHA) {
+            alpha = max(alpha, entry.score);
+        } else {
+            beta = min(beta, entry.score);
         }
-        if (alpha > beta) {
+        if (alpha >= beta) {
             bestMove = entry.move;
             return entry.score;
         }
@@ -174,73 +275,53 @@ int Search::negamaxRoot(Board &b, int depth, int alpha, int beta) {
         return score;
     }
 
-    std::vector<Move> moves;
-    std::vector<MoveData> moveList;
-    b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) : getLegalMoves<nBlack>(moves, b);
-
-    Search::orderMoves(b, moves, moveList, ply);
-
+    MovePicker picker(b, entry.move, killerMoves[ply]);
+    Move m;
     unsigned int loc = 0;
 
-    for (MoveData mv : moveList) {
+    while ((m = picker.next()) != Move()) {
         loc++;
-        auto time = chrono::high_resolution_clock::now();
-        auto dur = time - info->startTime;
-        if (2 * loc > moveList.size() && ((info->duration != 0 && 
-                info->duration <=
-                chrono::duration_cast<std::chrono::milliseconds>(dur).count())
-                || info->stopped)) {
-            info->stopped = true;
-            return alpha;
-        }
 
-        Move m = mv.move;
         int searchVal;
-        if (b.isLegal(m)) {
-            b.makeMove(m);
-            if (loc > 1) {
-                searchVal = -negamax(b, depth - 1, -alpha - 1, -alpha, false,
-                        true);
-                if (alpha < searchVal && searchVal < beta) {
-                    searchVal = -negamax(b, depth - 1, -beta, -searchVal, false, true);
-                }
-            } else {
-                searchVal = -negamax(b, depth - 1, -beta, -alpha, true, true);
+        unsigned long long moveStart = nodes;
+        b.makeMove(m);
+        if (loc > 1) {
+            searchVal = -negamax(b, depth - 1, -alpha - 1, -alpha, false,
+                    true);
+            if (alpha < searchVal && searchVal < beta) {
+                searchVal = -negamax(b, depth - 1, -beta, -searchVal, false, true);
             }
-            b.unmakeMove(m);
-            if (searchVal > alpha) {
-                bestMove = m;
-            }
-            alpha = max(searchVal, alpha);
+        } else {
+            searchVal = -negamax(b, depth - 1, -beta, -alpha, true, true);
+        }
+        b.unmakeMove(m);
+        // a move whose search was cut short cannot become the best move,
+        // unless there is none yet, so a search stopped at once still has
+        // its first root move
+        if (info->stopped && bestMove != Move()) {
+            return alpha;
+        }
+        if (searchVal > alpha) {
+            bestMove = m;
+            bestMoveNodes = nodes - moveStart;
+        }
+        alpha = max(searchVal, alpha);
 
-            if (alpha >= beta) {
-                b.killerMoves[ply][1] = b.killerMoves[ply][0];
-                b.killerMoves[ply][0] = m;
-                break;
-            }
+        if (alpha >= beta) {
+            storeKiller(m, ply);
+            break;
         }
     }
 
-    entry.score = alpha;
-    entry.depth = depth;
-    entry.move = bestMove;
-
+    HashType nodeType;
     if (alpha <= oldAlpha) {
-        entry.nodeType = HASH_BETA;
+        nodeType = HASH_BETA;
     } else if (alpha >= beta) {
-        entry.nodeType = HASH_ALPHA;
+        nodeType = HASH_ALPHA;
     } else {
-        entry.nodeType = HASH_EXACT;
-    }
-
-    if (oldEntry.nodeType != HASH_EXACT && entry.nodeType == HASH_EXACT) {
-        b.setTransTable(hashKey, entry);
-    }
-    if (!(oldEntry.nodeType == HASH_EXACT && entry.nodeType != HASH_EXACT)) {
-        if (entry.depth >= oldEntry.depth) {
-            b.setTransTable(hashKey, entry);
-        }
+        nodeType = HASH_EXACT;
     }
+    TT.store(b.getZobrist(), depth, alpha, nodeType, bestMove);
 
     return alpha;
 }
@@ -248,59 +329,42 @@ int Search::negamaxRoot(Board &b, int depth, int alpha, int beta) {
 
 // Performs quiescence search on the given board
 int Search::quiesce(Board &b, int alpha, int beta) {
-    int stand_pat = b.boardScore();
-    info->nodes++;
+    if (info->stopped) {
+        return alpha;
+    }
+    HashEntry entry;
+    TT.probe(b.getZobrist(), entry);
+    int stand_pat = (entry.eval != EVAL_NONE ? entry.eval : evaluate(b));
+    countNode();
     if (stand_pat >= beta) {
         return beta;
     }
     if (alpha < stand_pat) {
         alpha = stand_pat;
     }
-    vector<Move> moves;
-    vector<MoveData> moveList;
-
-    b.getToMove() == nWhite ? getCaptures<nWhite>(moves, b) : getCaptures<nBlack>(moves, b);
-    Search::orderMoves(b, moves, moveList, -1);
-    for (MoveData md : moveList)  {
-        Move m = md.move;
-        if (b.isLegal(m)) {
-            b.makeMove(m);
-            int score = -quiesce(b, -beta, -alpha);
-            b.unmakeMove(m);
-
-            if (score >= beta) {
-                return beta;
-            }
-            if (score > alpha) {
-                alpha = score;
-            }
+    MovePicker picker(b, entry.move);
+    Move m;
+    while ((m = picker.next()) != Move()) {
+        b.makeMove(m);
+        int score = -quiesce(b, -beta, -alpha);
+        b.unmakeMove(m);
+
+        if (score >= beta) {
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
         }
     }
     return alpha;
 }
 
 
-// Orders the moves in the given move list
-void Search::orderMoves(Board& b, std::vector<Move>& moveList, std::vector<MoveData>& moveScores, int ply) {
-    int hashKey = b.getZobrist() % TABLE_SIZE;
-    for (Move m : moveList) {
-        MoveData mv = MoveData(0, m);
-        if (b.getTransTable(hashKey).move == m) {
-            mv.score = 100000;
-        } else if (m.isCapture()) {
-            mv.score = PieceVals[b.getPiece(m.getTo())] -
-                b.getPiece(m.getFrom());
-        } else if (ply != -1) {
-            if (m == b.killerMoves[ply][0]) {
-                mv.score = 50;
-            } else if (m == b.killerMoves[ply][1]) {
-                mv.score = 49;
-            }
-        } else {
-            mv.score = 0;
-        }
-        moveScores.push_back(mv);
+// Stores a quiet move that caused a cutoff at the given ply. Captures are
+// already tried before the killers.
+void Search::storeKiller(Move m, int ply) {
+    if (!m.isCapture() && !m.isPromotion() && killerMoves[ply][0] != m) {
+        killerMoves[ply][1] = killerMoves[ply][0];
+        killerMoves[ply][0] = m;
     }
-
-    std::sort(moveScores.begin(), moveScores.end(), sortMoves());
 }
@@ -4,52 +4,73 @@
 #include <utility>
 #include "board.hpp"
 #include "movegen.hpp"
+#include "movepick.hpp"
 #include <chrono>
+#include <atomic>
+#include "smp.hpp"
+#include "evalcache.hpp"
+#include "timeman.hpp"
 
 extern const int MAX_VALUE;
 extern const int MATE_VALUE;
 
-struct MoveData {
-    Move move;
-    int score;
-
-    MoveData(int score, Move m) {
-        this->move = m;
-        this->score = score;
-    }
-    
-    MoveData() {
-        this->move = Move();
-        this->score = 0;
-    }
-};
+// Maximum number of plies searched from the root
+const int MAX_PLY = 128;
 
 struct SearchInfo {
-	chrono::high_resolution_clock::time_point startTime;
-	chrono::high_resolution_clock::time_point time;
+    // decides how long the search may take
+    TimeManager timeManager;
+    // nodes each search thread may search, zero for no limit
+    unsigned long long nodeLimit;
     int depth;
-    long duration; // in ms
-    int nodes;
     bool infinite;
-    bool stopped;
+    // shared by every search thread
+    std::atomic<bool> stopped;
 
     SearchInfo() {
+        nodeLimit = 0;
         depth = 0;
-        duration = 0;
-        nodes = 0;
         infinite = false;
         stopped = true;
     }
 };
 
-struct sortMoves {
-    bool operator()(MoveData const &a, MoveData const &b) { 
-            return a.score > b.score;
-    }
-};
-
 class Search {
     SearchInfo* info;
+    // Holds the depth of the current iteration
+    int rootDepth;
+
+    // Counts a searched node, and stops the search on its last node when
+    // the node limit is reached, or every TIME_CHECK_NODES nodes once the
+    // maximum time is used up. Only this object's thread writes the
+    // counter, so a relaxed load and store avoids a locked increment.
+    inline void countNode() {
+        unsigned long long n = nodes.load(std::memory_order_relaxed) + 1;
+        nodes.store(n, std::memory_order_relaxed);
+        if (n == info->nodeLimit || (n % TIME_CHECK_NODES == 0 &&
+                    info->timeManager.outOfTime())) {
+            info->stopped = true;
+        }
+    }
+
+    // Returns the static evaluation of the board, looking it up in the
+    // evaluation cache first
+    int evaluate(Board &b);
+
+    // Returns whether the search was stopped or a split point this thread
+    // is working for has failed high
+    bool aborted() const;
+
+    // Stores a quiet move that caused a cutoff at the given ply
+    void storeKiller(Move m, int ply);
+
+    // Searches a move after the first one at its node with a null window,
+    // reducing late quiet moves, and re-searches it if it raises alpha
+    int searchLateMove(Board &b, Move m, unsigned int loc, int depth, int
+            alpha, int beta);
+
+    // Searches the remaining moves of a split point, sharing its bounds
+    void searchSplit(Board &b, SplitPoint* sp);
 public:
     // Constructs a new search object
     Search(SearchInfo* info);
@@ -57,6 +78,26 @@ public:
     // Holds the best move for the search
     Move bestMove; 
 
+    // Holds the nodes searched below the best move in the last root search
+    unsigned long long bestMoveNodes;
+
+    // Holds the killer moves list
+    Move killerMoves[MAX_PLY][2];
+
+    // Holds the number of nodes searched, read by the reporting thread
+    std::atomic<unsigned long long> nodes;
+
+    // Holds the number of evaluation cache lookups and hits, read by the
+    // reporting thread
+    std::atomic<unsigned long long> evalProbes;
+    std::atomic<unsigned long long> evalHits;
+
+    // Holds the helper threads for split point search, or null
+    SplitPool* pool;
+
+    // Holds the split point this thread is currently working for, or null
+    SplitPoint* splitPoint;
+
     int negamax(Board &b, int depth, int alpha, int beta, bool pv, bool
             nullOkay);
 
@@ -65,7 +106,7 @@ public:
     // Performs quiescence search on the given board
     int quiesce(Board &b, int alpha, int beta);
 
-    // Orders the moves in the given move list
-    void orderMoves(Board& b, std::vector<Move>& moveList, std::vector<MoveData>& moveScores, int ply);
+    // Joins a split point published by another thread as a helper
+    void helpSplit(Board &b, SplitPoint* sp);
 };
 #endif /*SEARCH_HPP*/
@@ -0,0 +1,122 @@
+#include "smp.hpp"
+#include "search.hpp"
+#include <algorithm>
+
+// Copies the board and points the picker at the copy, which stays at the node
+// while the master searches its moves
+SplitPoint::SplitPoint(const Board& b, SplitPoint* parent, MovePicker* picker,
+        unsigned int moveCount, int depth, int ply, int alpha, int beta,
+        Move bestMove) : board(b) {
+    this->parent = parent;
+    this->picker = picker;
+    this->moveCount = moveCount;
+    this->depth = depth;
+    this->ply = ply;
+    this->alpha = alpha;
+    this->beta = beta;
+    this->bestMove = bestMove;
+    finished = false;
+    cutoff = false;
+    workers = 0;
+    picker->setBoard(board);
+}
+
+
+// Starts the given number of helper threads
+SplitPool::SplitPool(SearchInfo* info, int count) {
+    idle = 0;
+    quit = false;
+    for (int i = 0; i < count; i++) {
+        searches.push_back(std::unique_ptr<Search>(new Search(info)));
+        searches.back()->pool = this;
+    }
+    for (int i = 0; i < count; i++) {
+        threads.push_back(std::thread(&SplitPool::idleLoop, this,
+                    searches[i].get()));
+    }
+}
+
+
+// Stops and joins the helper threads
+SplitPool::~SplitPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread& th : threads) {
+        th.join();
+    }
+}
+
+
+// Waits for split points and helps search them until the pool is closed
+void SplitPool::idleLoop(Search* search) {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        idle++;
+        wake.wait(guard, [this] { return quit || !queue.empty(); });
+        idle--;
+        if (quit) {
+            return;
+        }
+
+        SplitPoint* sp = queue.front();
+        if (sp->finished || sp->cutoff) { // nothing left
+            queue.pop_front();
+            continue;
+        }
+        sp->workers++;
+        guard.unlock();
+
+        Board board = sp->board;
+        search->helpSplit(board, sp);
+        sp->workers--;
+
+        guard.lock();
+    }
+}
+
+
+// Returns whether any helper is waiting for work
+bool SplitPool::hasIdle() const {
+    return idle > 0;
+}
+
+
+// Makes a split point available to idle helpers
+void SplitPool::publish(SplitPoint* sp) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(sp);
+    }
+    wake.notify_all();
+}
+
+
+// Removes a split point so no further helpers join it
+void SplitPool::retract(SplitPoint* sp) {
+    std::lock_guard<std::mutex> guard(lock);
+    queue.erase(std::remove(queue.begin(), queue.end(), sp), queue.end());
+}
+
+
+// Returns the number of nodes searched by the helpers
+unsigned long long SplitPool::nodes() const {
+    unsigned long long total = 0;
+    for (const std::unique_ptr<Search>& search : searches) {
+        total += search->nodes;
+    }
+    return total;
+}
+
+
+// Adds the evaluation cache lookups and hits of the helpers to the given
+// counters
+void SplitPool::evalStats(unsigned long long& probes, unsigned long long&
+        hits) const {
+    for (const std::unique_ptr<Search>& search : searches) {
+        probes += search->evalProbes;
+        hits += search->evalHits;
+    }
+}
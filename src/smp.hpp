@@ -0,0 +1,95 @@
+#ifndef SMP_HPP
+#define SMP_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "board.hpp"
+
+// Minimum remaining depth at which a node may be split between threads
+const int SPLIT_DEPTH = 4;
+
+enum SMPMode {
+    SMP_LAZY,
+    SMP_YBWC
+};
+
+class Search;
+struct SearchInfo;
+class MovePicker;
+
+// Holds a node whose remaining moves are searched by several threads. The
+// master thread creates it on its stack once the first move of the node has
+// been searched, and helpers take moves from its picker until none are left.
+struct SplitPoint {
+    // position at the node, copied by each helper
+    Board board;
+    // split point the master was itself helping with, if any
+    SplitPoint* parent;
+    // hands out the remaining moves of the node, guarded by lock
+    MovePicker* picker;
+    // number of moves handed out so far, guarded by lock
+    unsigned int moveCount;
+    // set once the picker has no moves left
+    std::atomic<bool> finished;
+    int depth;
+    int ply;
+    int beta;
+    // guarded by lock
+    int alpha;
+    Move bestMove;
+    std::mutex lock;
+    // set when a move fails high, aborting the searches of its siblings
+    std::atomic<bool> cutoff;
+    // number of helpers currently searching moves of this split point
+    std::atomic<int> workers;
+
+    // Copies the board and points the picker at the copy, which stays at
+    // the node while the master searches its moves
+    SplitPoint(const Board& b, SplitPoint* parent, MovePicker* picker,
+            unsigned int moveCount, int depth, int ply, int alpha, int beta,
+            Move bestMove);
+};
+
+// Holds the idle helper threads of the split point search
+class SplitPool {
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Search>> searches;
+    std::mutex lock;
+    std::condition_variable wake;
+    // split points that still have moves to hand out
+    std::deque<SplitPoint*> queue;
+    std::atomic<int> idle;
+    bool quit;
+
+    // Waits for split points and helps search them until the pool is closed
+    void idleLoop(Search* search);
+public:
+    // Starts the given number of helper threads
+    SplitPool(SearchInfo* info, int count);
+
+    // Stops and joins the helper threads
+    ~SplitPool();
+
+    // Returns whether any helper is waiting for work
+    bool hasIdle() const;
+
+    // Makes a split point available to idle helpers
+    void publish(SplitPoint* sp);
+
+    // Removes a split point so no further helpers join it
+    void retract(SplitPoint* sp);
+
+    // Returns the number of nodes searched by the helpers
+    unsigned long long nodes() const;
+
+    // Adds the evaluation cache lookups and hits of the helpers to the given
+    // counters
+    void evalStats(unsigned long long& probes, unsigned long long& hits) const;
+};
+
+#endif
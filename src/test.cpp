@@ -1,9 +1,22 @@
+#include <cstdlib>
+#include <cstring>
 #include "board.hpp"
 #include "search.hpp"
 #include "uci.hpp"
 
-int main() {
-    UCI uci = UCI();
+// Runs the UCI loop, or with "bench [depth] [threads] [hash]" as the
+// arguments runs the bench and exits
+int main(int argc, char* argv[]) {
+    UCI uci;
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        int depth = (argc > 2 ? atoi(argv[2]) : DEFAULT_BENCH_DEPTH);
+        int threads = (argc > 3 ? atoi(argv[3]) : 1);
+        int hashMb = (argc > 4 ? atoi(argv[4]) : DEFAULT_HASH_MB);
+        if (depth > 0 && threads > 0 && hashMb > 0) {
+            uci.bench(depth, std::min(threads, MAX_THREADS), hashMb);
+        }
+        return 0;
+    }
 	uci.loop();
 
     return 0;
@@ -0,0 +1,96 @@
+#include "timeman.hpp"
+#include <algorithm>
+
+TimeManager::TimeManager() {
+    startTime = std::chrono::steady_clock::now();
+    optimumTime = 0;
+    maximumTime = 0;
+    adjustable = false;
+    bestMoveChanges = 0;
+    scale = 1;
+}
+
+
+// Starts the clock and computes the budgets for the side to move. With a
+// fixed move time both budgets are that time. Otherwise the clock is shared
+// out over the moves to go, or over 40 moves in sudden death, plus most of
+// the increment. The maximum allows a hard move four times the optimum, but
+// never more than half the clock unless this is the last move before the
+// time control.
+void TimeManager::init(const SearchLimits& limits, Color us, long
+        moveOverhead) {
+    startTime = std::chrono::steady_clock::now();
+    optimumTime = 0;
+    maximumTime = 0;
+    adjustable = false;
+    bestMoveChanges = 0;
+    scale = 1;
+    if (limits.moveTime) {
+        optimumTime = maximumTime = limits.moveTime;
+        return;
+    }
+    if (!limits.time[us]) {
+        return;
+    }
+
+    adjustable = true;
+    long time = limits.time[us];
+    long inc = limits.inc[us];
+    int movesToGo = (limits.movesToGo > 0 ? std::min(limits.movesToGo, 40) :
+            40);
+    long safe = std::max(time - moveOverhead, 1L);
+
+    optimumTime = time / movesToGo + inc * 3 / 4;
+    maximumTime = std::min(optimumTime * 4, movesToGo == 1 ? safe : safe / 2);
+    maximumTime = std::max(maximumTime, 1L);
+    optimumTime = std::max(std::min(optimumTime, maximumTime), 1L);
+}
+
+
+// Returns the milliseconds since init was called
+long TimeManager::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+// Returns whether the maximum time has been used up
+bool TimeManager::outOfTime() const {
+    return maximumTime != 0 && elapsed() >= maximumTime;
+}
+
+
+// Scales the optimum after an iteration by how unsettled the search is. A
+// best move that keeps changing up to doubles it, and a score that dropped
+// by half a pawn or more adds half, while a rising score takes off up to a
+// quarter. A best move that took nearly all the nodes, so the other moves
+// were refuted quickly, cuts it by up to 40%, and one that took under half
+// adds up to a fifth.
+void TimeManager::update(bool bestMoveChanged, int scoreDrop, double
+        bestMoveEffort) {
+    bestMoveChanges = bestMoveChanges / 2 + (bestMoveChanged ? 1 : 0);
+    if (!adjustable) {
+        return;
+    }
+    double instability = 1 + bestMoveChanges / 2;
+    double falling = std::max(0.75, std::min(1.5, 1 + scoreDrop / 100.0));
+    double effort = std::max(0.6, std::min(1.2, 1.6 - bestMoveEffort));
+    scale = instability * falling * effort;
+}
+
+
+// Returns whether iterative deepening should stop after an iteration that
+// took the given milliseconds. Each iteration takes three to five times as
+// long as the one before, so none is started once half the scaled optimum is
+// spent, which makes moves take about the optimum on average, or when it
+// could not finish before the maximum and would be cut short. A fixed move
+// time is not an average to aim for, so it is searched to the end, where the
+// root keeps the best move of the last iteration's finished moves.
+bool TimeManager::stopIterating(long lastIteration) const {
+    if (!maximumTime || !adjustable) {
+        return false;
+    }
+    long spent = elapsed();
+    long optimum = std::min((long)(optimumTime * scale), maximumTime);
+    return spent >= optimum / 2 || spent + 3 * lastIteration > maximumTime;
+}
@@ -0,0 +1,87 @@
+#ifndef TIMEMAN_HPP
+#define TIMEMAN_HPP
+
+#include <chrono>
+#include "bitboard.hpp"
+
+// Default time kept back on every move for communication and GUI delays, in
+// milliseconds
+const int DEFAULT_MOVE_OVERHEAD = 30;
+
+// Nodes a search thread searches between checks of the clock
+const unsigned long long TIME_CHECK_NODES = 1024;
+
+// Holds the limits given by a go command, times in milliseconds. Zero means
+// the field was not given.
+struct SearchLimits {
+    // time left on each side's clock, indexed by color
+    long time[2];
+    // increment per move of each side, indexed by color
+    long inc[2];
+    int movesToGo;
+    long moveTime;
+    // nodes each search thread may search
+    unsigned long long nodes;
+
+    SearchLimits() {
+        time[nWhite] = time[nBlack] = 0;
+        inc[nWhite] = inc[nBlack] = 0;
+        movesToGo = 0;
+        moveTime = 0;
+        nodes = 0;
+    }
+
+    // Returns whether the search is limited by time or nodes for the given
+    // side
+    bool limited(Color us) const {
+        return moveTime != 0 || time[us] != 0 || nodes != 0;
+    }
+};
+
+// Decides how long a search may take. The optimum is the time a move should
+// take on average, and the maximum a hard limit at which the search is
+// stopped even in the middle of an iteration.
+class TimeManager {
+    std::chrono::steady_clock::time_point startTime;
+    // both zero when the search is not limited by time
+    long optimumTime;
+    long maximumTime;
+    // whether the optimum may be scaled, false for a fixed move time
+    bool adjustable;
+    // the number of best move changes, halved after every iteration
+    double bestMoveChanges;
+    // the factor the optimum is scaled by
+    double scale;
+public:
+    TimeManager();
+
+    // Starts the clock and computes the budgets for the side to move
+    void init(const SearchLimits& limits, Color us, long moveOverhead);
+
+    // Returns the milliseconds since init was called
+    long elapsed() const;
+
+    // Returns whether the maximum time has been used up
+    bool outOfTime() const;
+
+    // Scales the optimum after an iteration by how unsettled the search is:
+    // whether the best move changed, how far the score dropped from the
+    // last iteration, and the fraction of the nodes spent on the best move
+    void update(bool bestMoveChanged, int scoreDrop, double bestMoveEffort);
+
+    // Returns whether iterative deepening should stop after an iteration
+    // that took the given milliseconds
+    bool stopIterating(long lastIteration) const;
+
+    // Returns the optimum time in milliseconds, or zero without a limit
+    long optimum() const {
+        return optimumTime;
+    }
+
+    // Returns the maximum time in milliseconds, or zero without a limit
+    long maximum() const {
+        return maximumTime;
+    }
+};
+
+#endif
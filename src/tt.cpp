@@ -0,0 +1,157 @@
+#include "tt.hpp"
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+TranspositionTable TT;
+
+TranspositionTable::TranspositionTable() {
+    table = nullptr;
+    memory = nullptr;
+    bucketCount = 0;
+    generation = 0;
+    resize(DEFAULT_HASH_MB);
+}
+
+
+TranspositionTable::~TranspositionTable() {
+    free(memory);
+}
+
+
+// Reallocates the table to use at most the given number of megabytes. The
+// bucket count is rounded down to a power of two so a key can be mapped to a
+// bucket with a mask.
+void TranspositionTable::resize(size_t mb) {
+    size_t buckets = (mb * 1024 * 1024) / sizeof(Bucket);
+    size_t newCount = 1;
+    while (newCount * 2 <= buckets) {
+        newCount *= 2;
+    }
+
+    free(memory);
+    memory = malloc(newCount * sizeof(Bucket) + 63);
+    if (!memory) {
+        std::cerr << "Failed to allocate " << mb << "MB for the hash table" <<
+            std::endl;
+        exit(EXIT_FAILURE);
+    }
+    table = (Bucket*)(((uintptr_t)memory + 63) & ~(uintptr_t)63);
+    bucketCount = newCount;
+    clear();
+}
+
+
+// Packs the fields of an entry into a single data word
+static inline unsigned long long packData(Move move, int score, int eval,
+        int depth, unsigned char genBound) {
+    return (unsigned long long)move.getData()
+        | (unsigned long long)(unsigned short)score << 16
+        | (unsigned long long)(unsigned short)eval << 32
+        | (unsigned long long)(unsigned char)depth << 48
+        | (unsigned long long)genBound << 56;
+}
+
+
+// Returns the generation/bound byte of a data word
+static inline unsigned char getGenBound(unsigned long long data) {
+    return data >> 56;
+}
+
+
+// Returns the depth of a data word
+static inline int getDepth(unsigned long long data) {
+    return (data >> 48) & 0xff;
+}
+
+
+// Empties every entry in the table
+void TranspositionTable::clear() {
+    unsigned long long empty = packData(Move(), 0, EVAL_NONE, 0, HASH_NULL);
+    for (size_t i = 0; i < bucketCount; i++) {
+        for (int j = 0; j < BUCKET_SIZE; j++) {
+            table[i].entries[j].data.store(empty, std::memory_order_relaxed);
+            table[i].entries[j].keyXor.store(empty, std::memory_order_relaxed);
+        }
+    }
+    generation = 0;
+}
+
+
+// Marks the start of a new search so older entries can be replaced
+void TranspositionTable::newSearch() {
+    generation += 4;
+}
+
+
+// Returns the bucket the given key maps to
+Bucket* TranspositionTable::getBucket(unsigned long long key) const {
+    return &table[key & (bucketCount - 1)];
+}
+
+
+// Looks up the given key, copying the entry and returning true on a hit
+bool TranspositionTable::probe(unsigned long long key, HashEntry& entry) const {
+    Bucket* bucket = getBucket(key);
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        unsigned long long data =
+            bucket->entries[i].data.load(std::memory_order_relaxed);
+        unsigned long long keyXor =
+            bucket->entries[i].keyXor.load(std::memory_order_relaxed);
+        if ((keyXor ^ data) == key && (getGenBound(data) & 3) != HASH_NULL) {
+            entry.move = Move((unsigned short)data);
+            entry.score = (short)(data >> 16);
+            entry.eval = (short)(data >> 32);
+            entry.depth = getDepth(data);
+            entry.nodeType = (HashType)(getGenBound(data) & 3);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Stores a search result for the given key. An entry for the same position is
+// overwritten unless it holds an exact score from a deeper search of the
+// current generation; otherwise the entry with the lowest depth, counting
+// older generations as shallower, is replaced.
+void TranspositionTable::store(unsigned long long key, int depth, int score,
+        HashType nodeType, Move move, int eval) {
+    Bucket* bucket = getBucket(key);
+    PackedEntry* replace = &bucket->entries[0];
+    int replaceValue = 1 << 30;
+
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        PackedEntry* entry = &bucket->entries[i];
+        unsigned long long data = entry->data.load(std::memory_order_relaxed);
+        unsigned long long keyXor =
+            entry->keyXor.load(std::memory_order_relaxed);
+        unsigned char genBound = getGenBound(data);
+        HashType oldType = (HashType)(genBound & 3);
+
+        if (oldType == HASH_NULL || (keyXor ^ data) == key) {
+            if (oldType == HASH_EXACT && nodeType != HASH_EXACT &&
+                    getDepth(data) > depth && (genBound & ~3) == generation) {
+                return;
+            }
+            if (move == Move() && oldType != HASH_NULL) {
+                move = Move((unsigned short)data);
+            }
+            replace = entry;
+            break;
+        }
+
+        int age = (unsigned char)(generation - (genBound & ~3)) >> 2;
+        if (getDepth(data) - 8 * age < replaceValue) {
+            replace = entry;
+            replaceValue = getDepth(data) - 8 * age;
+        }
+    }
+
+    unsigned long long data = packData(move,
+            std::max(-32767, std::min(32767, score)), eval,
+            std::max(0, std::min(depth, 255)), generation | nodeType);
+    replace->data.store(data, std::memory_order_relaxed);
+    replace->keyXor.store(key ^ data, std::memory_order_relaxed);
+}
@@ -0,0 +1,96 @@
+#ifndef TT_HPP
+#define TT_HPP
+
+#include <cstddef>
+#include <atomic>
+#include "move.hpp"
+
+enum HashType {
+    HASH_EXACT,
+    HASH_ALPHA,
+    HASH_BETA,
+    HASH_NULL
+};
+
+// Marks a hash entry without a stored static evaluation
+const int EVAL_NONE = 32767;
+
+// Holds the unpacked contents of a transposition table entry
+struct HashEntry {
+    int depth;
+    int score;
+    int eval;
+    HashType nodeType;
+    Move move;
+
+    HashEntry() {
+        this->depth = 0;
+        this->score = 0;
+        this->eval = EVAL_NONE;
+        this->nodeType = HASH_NULL;
+        this->move = Move();
+    }
+};
+
+// Holds an entry as it is stored in the table. The move, score, eval, depth
+// and generation/bound byte are packed into one 64 bit data word, and the key
+// is stored XORed with that word. Threads read and write both words without
+// locking; an entry torn by a concurrent write fails the key check and is
+// treated as a miss.
+struct PackedEntry {
+    std::atomic<unsigned long long> keyXor;
+    std::atomic<unsigned long long> data;
+};
+
+// Number of entries that share one bucket
+const int BUCKET_SIZE = 4;
+
+// Holds four 16 byte entries, filling one cache line
+struct alignas(64) Bucket {
+    PackedEntry entries[BUCKET_SIZE];
+};
+
+static_assert(sizeof(Bucket) == 64, "Bucket must be 64 bytes");
+
+// Default size of the transposition table in megabytes
+const int DEFAULT_HASH_MB = 16;
+
+class TranspositionTable {
+    // Holds the buckets, aligned to the start of a cache line
+    Bucket* table;
+    // Holds the unaligned allocation backing the table
+    void* memory;
+    // Number of buckets, always a power of two
+    size_t bucketCount;
+    // Holds the generation of the current search, in the upper 6 bits
+    unsigned char generation;
+
+    // Returns the bucket the given key maps to
+    Bucket* getBucket(unsigned long long key) const;
+public:
+    // Constructs a table of the default size
+    TranspositionTable();
+
+    ~TranspositionTable();
+
+    // Reallocates the table to use at most the given number of megabytes
+    void resize(size_t mb);
+
+    // Empties every entry in the table
+    void clear();
+
+    // Marks the start of a new search so older entries can be replaced
+    void newSearch();
+
+    // Looks up the given key, copying the entry and returning true on a hit
+    bool probe(unsigned long long key, HashEntry& entry) const;
+
+    // Stores a search result for the given key
+    void store(unsigned long long key, int depth, int score, HashType nodeType,
+            Move move, int eval = EVAL_NONE);
+};
+
+// The transposition table shared by every search
+extern TranspositionTable TT;
+
+#endif
@@ -2,12 +2,100 @@
 
 using namespace std;
 
+// Positions searched by the bench command: openings, middlegames, endgames
+// and positions with few pieces. The total node count of a bench is a
+// signature of the search, so changing these changes the signature.
+static const char* const benchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+};
+
+// Captures with known static exchange values, checked by the seetest command
+static const struct {
+    const char* fen;
+    const char* move;
+    int value;
+} seePositions[] = {
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100},
+    {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -200},
+    {"8/8/8/8/3k4/4p3/8/3KR3 w - - 0 1", "e1e3", -400},
+    {"8/8/8/8/3k4/4p3/5P2/3KR3 w - - 0 1", "e1e3", 100},
+    {"8/8/P7/5P1R/Kpbp4/1Pk1r3/3N4/R1B5 b - - 0 1", "c4b3", -225},
+};
+
+// Checks see and seeGe against the known values of seePositions, printing
+// every position and whether it passed
+static void testSee() {
+    int failed = 0;
+    for (auto& test : seePositions) {
+        Board board(test.fen);
+        MoveList moves;
+        board.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, board) :
+            getLegalMoves<nBlack>(moves, board);
+        Move m;
+        for (Move legal : moves) {
+            if (legal.toStr() == test.move) {
+                m = legal;
+            }
+        }
+        int value = board.see(m);
+        bool ok = m != Move() && value == test.value &&
+            board.seeGe(m, test.value) && !board.seeGe(m, test.value + 1);
+        failed += !ok;
+        cout << test.fen << " " << test.move << ": see " << value <<
+            ", expected " << test.value << (ok ? "" : " FAILED") << endl;
+    }
+    cout << (failed ? "see tests failed" : "see tests passed") << endl;
+}
+
 UCI::UCI() {
-    wtime = 0;
+    initBitboards();
+    moveOverhead = DEFAULT_MOVE_OVERHEAD;
+    hashMb = DEFAULT_HASH_MB;
+    threads = 1;
+    smpMode = SMP_LAZY;
+    perftHashMb = DEFAULT_PERFT_HASH_MB;
 }
 void UCI::loop() {
     string start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
-    initBitboards();
 
     //b.printBoard();
     std::string line;
@@ -21,10 +109,56 @@ void UCI::loop() {
         if (token == "uci") {
             cout << "id name Engine" << endl;
             cout << "id author Brock Grassy" << endl;
+            cout << "option name Hash type spin default " << DEFAULT_HASH_MB
+                << " min 1 max 65536" << endl;
+            cout << "option name Threads type spin default 1 min 1 max " <<
+                MAX_THREADS << endl;
+            cout << "option name SMP Mode type combo default LazySMP var LazySMP"
+                << " var YBWC" << endl;
+            cout << "option name Perft Hash type spin default " <<
+                DEFAULT_PERFT_HASH_MB << " min 0 max 65536" << endl;
+            cout << "option name Move Overhead type spin default " <<
+                DEFAULT_MOVE_OVERHEAD << " min 0 max 5000" << endl;
             cout << "uciok" << endl;
         } else if (token == "isready") {
             cout << "readyok" << endl;
+        } else if (token == "setoption") {
+            string name;
+            is >> token; // name
+            while (is >> token && token != "value") {
+                name += (name.empty() ? "" : " ") + token;
+            }
+            if (name == "Hash" && info.stopped) {
+                int mb;
+                if (is >> mb && mb >= 1) {
+                    hashMb = mb;
+                    TT.resize(mb);
+                }
+            } else if (name == "Threads" && info.stopped) {
+                int n;
+                if (is >> n) {
+                    threads = std::max(1, std::min(n, MAX_THREADS));
+                }
+            } else if (name == "SMP Mode" && info.stopped) {
+                string mode;
+                is >> mode;
+                smpMode = (mode == "YBWC" ? SMP_YBWC : SMP_LAZY);
+            } else if (name == "Perft Hash" && info.stopped) {
+                int mb;
+                if (is >> mb && mb >= 0) {
+                    perftHashMb = mb;
+                }
+            } else if (name == "Move Overhead") {
+                int ms;
+                if (is >> ms && ms >= 0) {
+                    moveOverhead = ms;
+                }
+            }
         } else if (token == "ucinewgame") {
+            // start from empty tables, so searches are repeatable
+            TT.clear();
+            pawnTable.clear();
+            evalCache.clear();
             b.setPosition(start);
         } else if (token == "position") {
             is >> token;
@@ -47,23 +181,80 @@ void UCI::loop() {
                 }
             }
         } else if (token == "go") {
+            streampos args = is.tellg();
+            if (is >> token && token == "perft") { // go perft N
+                int depth = 0;
+                is >> depth;
+                if (info.stopped) {
+                    perftTable.resize(perftHashMb);
+                    runPerft(b, depth, false, threads, perftTable);
+                }
+                continue;
+            }
+            // not perft, so read the token again as a search limit
+            is.clear();
+            is.seekg(args);
             if (info.stopped) {
-                int max = 9;
-                info.duration = 0;
-                info.stopped = false;
+                // wait for a stopped search to exit before setting up the next
+                if (thr.joinable()) {
+                    thr.join();
+                }
+                int max = 0;
+                SearchLimits limits;
                 while (is >> token) {
                     if (token == "depth") {
                         is >> max;
-                    } if (token == "movetime") {
-                        is >> info.duration;
-                    } if (token == "infinite") {
+                    } else if (token == "movetime") {
+                        is >> limits.moveTime;
+                    } else if (token == "wtime") {
+                        is >> limits.time[nWhite];
+                    } else if (token == "btime") {
+                        is >> limits.time[nBlack];
+                    } else if (token == "winc") {
+                        is >> limits.inc[nWhite];
+                    } else if (token == "binc") {
+                        is >> limits.inc[nBlack];
+                    } else if (token == "movestogo") {
+                        is >> limits.movesToGo;
+                    } else if (token == "nodes") {
+                        is >> limits.nodes;
+                    } else if (token == "infinite") {
                         max = 1000;
                     }
                 }
-                thread th1(&UCI::findMove, this, max);
-                th1.detach();
+                // a limited search goes as deep as its limits allow
+                if (max <= 0) {
+                    max = (limits.limited(b.getToMove()) ? 1000 : 9);
+                }
+                info.timeManager.init(limits, b.getToMove(), moveOverhead);
+                info.nodeLimit = limits.nodes;
+                info.stopped = false;
+                thr = thread(&UCI::findMove, this, max, true);
             }
 
+        } else if (token == "divide") {
+            int depth = 0;
+            is >> depth;
+            if (info.stopped) {
+                perftTable.resize(perftHashMb);
+                runPerft(b, depth, true, threads, perftTable);
+            }
+        } else if (token == "benchsliders") {
+            int count = 10000000;
+            is >> count;
+            if (count > 0) {
+                benchSliders(count);
+            }
+        } else if (token == "seetest") {
+            testSee();
+        } else if (token == "bench") {
+            int depth = DEFAULT_BENCH_DEPTH;
+            int n = threads;
+            int mb = DEFAULT_HASH_MB;
+            is >> depth >> n >> mb;
+            if (info.stopped && depth > 0 && n > 0 && mb > 0) {
+                bench(depth, std::min(n, MAX_THREADS), mb);
+            }
         } else if (token == "stop") {
             info.stopped = true;
         } else if (token == "print") {
@@ -73,25 +264,59 @@ void UCI::loop() {
             break;
         } 
     }
+
+    info.stopped = true;
+    if (thr.joinable()) {
+        thr.join();
+    }
 }
 
-void UCI::findMove(int max) {
-    vector<Move> moveList;
+// Searches the best move to the given depth, printing the search when
+// verbose, and returns the nodes searched by every thread
+unsigned long long UCI::findMove(int max, bool verbose) {
     Move bestMove;
     Search search(&info);
+    TT.newSearch();
+    max = std::min(max, MAX_PLY - 1);
 
-    for (int depth = 1; depth <= max; depth++) {
-        info.startTime = chrono::high_resolution_clock::now();
-        info.nodes = 0;
-
-        vector<Move> moves;
-        vector<MoveData> moveList;
+    // Lazy SMP: start the helper threads, each searching its own copy of the
+    // board. Split point search instead keeps them idle in a pool until the
+    // main search hands them moves.
+    int lazyHelpers = (smpMode == SMP_LAZY ? threads - 1 : 0);
+    vector<Board> boards(lazyHelpers, b);
+    vector<unique_ptr<Search>> helpers;
+    vector<thread> helperThreads;
+    unique_ptr<SplitPool> pool;
+    if (smpMode == SMP_YBWC && threads > 1) {
+        pool.reset(new SplitPool(&info, threads - 1));
+        search.pool = pool.get();
+    }
+    for (int i = 0; i < lazyHelpers; i++) {
+        helpers.push_back(unique_ptr<Search>(new Search(&info)));
+    }
+    for (int i = 0; i < lazyHelpers; i++) {
+        helperThreads.push_back(thread(&UCI::helperSearch, this, &boards[i],
+                    helpers[i].get(), i + 1, max));
+    }
 
-        b.getToMove() == nWhite ? getAllMoves<nWhite>(moves, b) : getAllMoves<nBlack>(moves, b);
-        search.orderMoves(b, moves, moveList, -1);
+    // returns the nodes searched by every thread so far
+    auto totalNodes = [&]() {
+        unsigned long long nodes = search.nodes;
+        for (unique_ptr<Search>& helper : helpers) {
+            nodes += helper->nodes;
+        }
+        if (pool) {
+            nodes += pool->nodes();
+        }
+        return nodes;
+    };
 
+    Move previousBest;
+    int previousScore = 0;
+    for (int depth = 1; depth <= max; depth++) {
         info.depth = depth;
-        info.nodes = 0;
+        long iterationStart = info.timeManager.elapsed();
+        unsigned long long iterationNodes = search.nodes;
         int score = search.negamaxRoot(b, depth, -MAX_VALUE, MAX_VALUE);
         bestMove = search.bestMove;
 
@@ -99,28 +324,151 @@ void UCI::findMove(int max) {
             break;
         }
 
-        auto time = chrono::high_resolution_clock::now();
-        auto dur = time - info.startTime;
-        cout << "info depth " << depth << " nodes " << info.nodes << " score cp ";
-        cout << score << " pv";
-        b.printPV(depth);
-        if (chrono::duration_cast<std::chrono::milliseconds>(dur).count() != 0) {
-            cout << " nps " << (int)(0.5 + info.nodes * 1000.0 /
-                    chrono::duration_cast<std::chrono::milliseconds>(dur).count());
+        unsigned long long nodes = totalNodes();
+        long elapsed = info.timeManager.elapsed();
+        if (verbose) {
+            cout << "info depth " << depth << " nodes " << nodes << " time " <<
+                elapsed << " score cp ";
+            cout << score << " pv";
+            b.printPV(depth);
+            if (elapsed != 0) {
+                cout << " nps " << (unsigned long long)(0.5 + nodes * 1000.0 /
+                        elapsed);
+            }
+            cout << endl;
+        }
+
+        // spend more time when the search is unsettled, less when it is not
+        iterationNodes = search.nodes - iterationNodes;
+        if (depth > 1) {
+            info.timeManager.update(bestMove != previousBest, previousScore -
+                    score, iterationNodes ? (double)search.bestMoveNodes /
+                    iterationNodes : 1.0);
         }
-        cout << endl; 
+        previousBest = bestMove;
+        previousScore = score;
+
+        if (info.timeManager.stopIterating(elapsed - iterationStart)) {
+            break;
+        }
+    }
+
+    info.stopped = true;
+    for (thread& th : helperThreads) {
+        th.join();
+    }
+    unsigned long long nodes = totalNodes();
+    if (!verbose) {
+        return nodes;
+    }
+    cout << "info nodes " << nodes << " time " << info.timeManager.elapsed()
+        << endl;
+
+    unsigned long long evalProbes = search.evalProbes;
+    unsigned long long evalHits = search.evalHits;
+    for (unique_ptr<Search>& helper : helpers) {
+        evalProbes += helper->evalProbes;
+        evalHits += helper->evalHits;
     }
+    if (pool) {
+        pool->evalStats(evalProbes, evalHits);
+    }
+    cout << "info string eval cache hits " << evalHits << " of " <<
+        evalProbes << " (" << (evalProbes ? evalHits * 100 / evalProbes : 0)
+        << "%)" << endl;
+
+    // fall back on the hash move or the first legal move if the search has
+    // no best move, and on the null move only when there are no legal moves
+    if (bestMove == Move()) {
+        MoveList moves;
+        b.getToMove() == nWhite ? getLegalMoves<nWhite>(moves, b) :
+            getLegalMoves<nBlack>(moves, b);
+        HashEntry entry;
+        bool hashMove = TT.probe(b.getZobrist(), entry);
+        for (Move m : moves) {
+            if (bestMove == Move() || (hashMove && m == entry.move)) {
+                bestMove = m;
+            }
+        }
+    }
+    if (bestMove == Move()) {
+        cout << "bestmove 0000" << endl;
+        return nodes;
+    }
+
     b.makeMove(bestMove);
     cout << endl;
     b.printBoard();
     cout << "bestmove " << bestMove.toStr() << endl;
-    info.stopped = true;
+    return nodes;
+}
+
+
+// Searches every bench position to the given depth on empty tables and prints
+// the total nodes, time and nodes per second. With one thread the node total
+// is the same on every run and machine, so it shows whether a change altered
+// the search. The thread count, hash size and position in use are restored
+// afterwards, but the tables are left empty.
+void UCI::bench(int depth, int threads, int hashMb) {
+    int savedThreads = this->threads;
+    Board savedBoard = b;
+    this->threads = threads;
+    TT.resize(hashMb);
+
+    const int count = sizeof(benchPositions) / sizeof(benchPositions[0]);
+    unsigned long long totalNodes = 0;
+    TimeManager timer;
+    timer.init(SearchLimits(), nWhite, 0);
+    for (int i = 0; i < count; i++) {
+        TT.clear();
+        pawnTable.clear();
+        evalCache.clear();
+        b.setPosition(benchPositions[i]);
+        info.timeManager.init(SearchLimits(), b.getToMove(), 0);
+        info.nodeLimit = 0;
+        info.stopped = false;
+        unsigned long long nodes = findMove(depth, false);
+        totalNodes += nodes;
+        cout << "position " << (i + 1) << "/" << count << " nodes " << nodes
+            << endl;
+    }
+    long elapsed = timer.elapsed();
+
+    cout << "===========================" << endl;
+    cout << "Total time (ms) : " << elapsed << endl;
+    cout << "Nodes searched  : " << totalNodes << endl;
+    cout << "Nodes/second    : " << (unsigned long long)(totalNodes * 1000.0 /
+            std::max(elapsed, 1L)) << endl;
+
+    this->threads = savedThreads;
+    b = savedBoard;
+    TT.resize(this->hashMb);
+}
+
+
+// Lazy SMP helper thread. Runs iterative deepening on a private board until
+// the main thread stops the search, sharing results only through the
+// transposition table. Helpers skip some iterations in a pattern depending on
+// their id, so they are spread across neighbouring depths.
+void UCI::helperSearch(Board* board, Search* search, int id, int max) {
+    static const int skipSize[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4,
+        4, 4, 4, 4, 4, 4};
+    static const int skipPhase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0,
+        1, 2, 3, 4, 5, 6, 7};
+    int index = (id - 1) % 20;
+
+    for (int depth = 1; depth <= max && !info.stopped; depth++) {
+        if (((depth + skipPhase[index]) / skipSize[index]) % 2) {
+            continue;
+        }
+        search->negamaxRoot(*board, depth, -MAX_VALUE, MAX_VALUE);
+    }
 }
 
 Move UCI::stringToMove(string s) {
-    vector<Move> moveList;     
-    b.getToMove() == nWhite ? getAllMoves<nWhite>(moveList, b) :
-        getAllMoves<nBlack>(moveList, b);
+    MoveList moveList;
+    b.getToMove() == nWhite ? getLegalMoves<nWhite>(moveList, b) :
+        getLegalMoves<nBlack>(moveList, b);
 
     for (Move m : moveList) {
         if (s == m.toStr()) {
@@ -2,17 +2,31 @@
 #include <string>
 #include "board.hpp"
 #include "search.hpp"
+#include "perft.hpp"
 #include <thread>
 #include <sstream>
+#include <memory>
 
 using namespace std;
 
+// Maximum number of search threads
+const int MAX_THREADS = 512;
+
+// Default depth of the bench command
+const int DEFAULT_BENCH_DEPTH = 7;
+
 class UCI {
-    unsigned int wtime;
-	unsigned int btime;
-	unsigned int winc;
-	unsigned int binc;
-	unsigned int movestogo;
+    // time kept back on every move, in milliseconds
+    int moveOverhead;
+    // size of the transposition table in megabytes
+    int hashMb;
+    // number of search threads, including the main one
+    int threads;
+    // how the search threads share work
+    SMPMode smpMode;
+    // size of the perft table in megabytes, zero to disable it
+    int perftHashMb;
+    PerftTable perftTable;
     Board b;
     SearchInfo info;
     thread thr;
@@ -20,5 +34,11 @@ public:
     UCI();
     void loop();
     Move stringToMove(string s);
-    void findMove(int max);
+    // Searches the best move to the given depth, printing the search when
+    // verbose, and returns the nodes searched by every thread
+    unsigned long long findMove(int max, bool verbose);
+    // Searches every bench position to the given depth on empty tables and
+    // prints the total nodes, time and nodes per second
+    void bench(int depth, int threads, int hashMb);
+    void helperSearch(Board* board, Search* search, int id, int max);
 };
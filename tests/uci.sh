@@ -0,0 +1,34 @@
+#!/bin/sh
+# Checks the engine's answers to UCI commands. Run with make test.
+ENGINE=${1:-./chess}
+failed=0
+
+# Prints the move after bestmove in the engine's answer to the given commands
+bestmove() {
+    printf "$1" | "$ENGINE" | sed -n 's/^bestmove \([^ ]*\).*/\1/p'
+}
+
+# Checks that a search from the starting position answers with a legal move
+check() {
+    move=$(bestmove "position startpos\n$1\n")
+    if [ -z "$move" ] || [ "$move" = "0000" ] || printf \
+            "position startpos moves $move\nquit\n" | "$ENGINE" |
+            grep -q INVALID; then
+        echo "FAILED: '$(echo "$1" | tr '\n' ' ')' gave bestmove '$move'"
+        failed=1
+    else
+        echo "ok: '$(echo "$1" | tr '\n' ' ')' gave bestmove $move"
+    fi
+}
+
+check "go nodes 1\nisready"
+check "go nodes 2\nisready"
+check "go depth 1\nisready"
+check "go infinite\nstop\nisready"
+
+if ! printf "seetest\nquit\n" | "$ENGINE" | grep -q "see tests passed"; then
+    echo "FAILED: seetest"
+    failed=1
+fi
+
+exit $failed
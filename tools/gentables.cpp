@@ -0,0 +1,147 @@
+/**
+ * Generates src/tables.cpp, the tables that would otherwise be built every
+ * time the engine starts: the magic sliding move databases, the pawn, knight
+ * and king attacks, pawn front spans and between and line bitboards, and the
+ * zobrist keys. The Makefile runs it before compiling the engine, so the
+ * tables are constant data in the binary and the engine starts without any
+ * set up.
+ */
+
+#define MAGICMOVES_GENERATOR
+#include "../src/MagicMoves.cpp"
+#include <cstdio>
+#include <cstddef>
+#include <random>
+
+typedef unsigned long long Bitboard;
+
+static const Bitboard AFile = 0x0101010101010101ULL;
+static const Bitboard BFile = AFile << 1;
+static const Bitboard GFile = AFile << 6;
+static const Bitboard HFile = AFile << 7;
+
+static Bitboard pawnAttacks[2][64];
+static Bitboard pawnFrontSpan[2][64];
+static Bitboard knightAttacks[64];
+static Bitboard kingAttacks[64];
+static Bitboard betweenBB[64][64];
+static Bitboard lineBB[64][64];
+
+// Seed of the zobrist keys. mt19937_64 is fully specified by the standard,
+// so every compiler generates the same keys.
+static const unsigned long long ZOBRIST_SEED = 0x9e3779b97f4a7c15ULL;
+
+static Bitboard zobristPieces[12][64];
+static Bitboard zobristCastling[4];
+static Bitboard zobristEnPassant[8];
+static Bitboard zobristBlackMove;
+
+
+// Fills the pawn, knight and king attacks, the pawn front spans and the
+// between and line bitboards. Needs the magic databases.
+static void initTables() {
+    for (int i = 0; i < 64; i++) {
+        Bitboard b = 1ULL << i;
+        pawnAttacks[0][i] = (b << 7) & ~HFile;
+        pawnAttacks[0][i] |= (b << 9) & ~AFile;
+        pawnAttacks[1][i] = (b >> 7) & ~AFile;
+        pawnAttacks[1][i] |= (b >> 9) & ~HFile;
+
+        knightAttacks[i] = (b << 17) & ~AFile;
+        knightAttacks[i] |= (b << 10) & ~AFile &~BFile;
+        knightAttacks[i] |= (b >>  6) & ~AFile & ~BFile;
+        knightAttacks[i] |= (b >> 15) & ~AFile;
+        knightAttacks[i] |= (b << 15) & ~HFile;
+        knightAttacks[i] |= (b <<  6) & ~GFile & ~HFile;
+        knightAttacks[i] |= (b >> 10) & ~GFile & ~HFile;
+        knightAttacks[i] |= (b >> 17) & ~HFile;
+
+        kingAttacks[i] = (b << 1) & ~AFile;
+        kingAttacks[i] |= (b >> 1) & ~HFile;
+        kingAttacks[i] |= (kingAttacks[i] << 8) | (kingAttacks[i] >> 8);
+        kingAttacks[i] |= (b << 8) | (b >> 8);
+
+        int rank = i / 8;
+        int file = i & 7;
+        Bitboard frontSpan = AFile << file;
+        if (file != 0) frontSpan |= AFile << (file - 1);
+        if (file != 7) frontSpan |= AFile << (file + 1);
+        pawnFrontSpan[0][i] = (rank == 7 ? 0 : frontSpan << (8 * (rank + 1)));
+        pawnFrontSpan[1][i] = frontSpan & ~(~0ULL << (8 * rank));
+
+        for (int j = 0; j < 64; j++) {
+            Bitboard both = b | (1ULL << j);
+            if (i == j) {
+                continue;
+            }
+            if (Bmagic(i, 0) & (1ULL << j)) {
+                betweenBB[i][j] = Bmagic(i, 1ULL << j) & Bmagic(j, b);
+                lineBB[i][j] = (Bmagic(i, 0) & Bmagic(j, 0)) | both;
+            } else if (Rmagic(i, 0) & (1ULL << j)) {
+                betweenBB[i][j] = Rmagic(i, 1ULL << j) & Rmagic(j, b);
+                lineBB[i][j] = (Rmagic(i, 0) & Rmagic(j, 0)) | both;
+            }
+        }
+    }
+}
+
+
+// Draws the 781 zobrist keys in a fixed order: pieces, castling rights, en
+// passant files, then the side to move
+static void initZobrist() {
+    std::mt19937_64 eng(ZOBRIST_SEED);
+    for (int piece = 0; piece < 12; piece++) {
+        for (int sq = 0; sq < 64; sq++) {
+            zobristPieces[piece][sq] = eng();
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        zobristCastling[i] = eng();
+    }
+    for (int i = 0; i < 8; i++) {
+        zobristEnPassant[i] = eng();
+    }
+    zobristBlackMove = eng();
+}
+
+
+// Prints a table as a constant array definition with the given declarator
+static void printTable(const char* declarator, const Bitboard* table, size_t
+        size) {
+    printf("extern const U64 %s = {\n", declarator);
+    for (size_t i = 0; i < size; i++) {
+        printf("%s0x%016llxULL%s", i % 4 == 0 ? "    " : " ", table[i],
+                i + 1 < size ? "," : "");
+        if (i % 4 == 3 || i + 1 == size) {
+            printf("\n");
+        }
+    }
+    printf("};\n\n");
+}
+
+
+int main() {
+    initmagicmoves();
+    initTables();
+    initZobrist();
+
+    printf("// Tables generated by tools/gentables.cpp at build time. "
+            "Do not edit.\n\n");
+    printf("#include \"board.hpp\"\n\n");
+    printTable("magicmovesbdb[5248]", magicmovesbdb, 5248);
+    printTable("magicmovesrdb[102400]", magicmovesrdb, 102400);
+    printTable("pawnAttacks[2][64]", &pawnAttacks[0][0], 2 * 64);
+    printTable("pawnFrontSpan[2][64]", &pawnFrontSpan[0][0], 2 * 64);
+    printTable("knightAttacks[64]", knightAttacks, 64);
+    printTable("kingAttacks[64]", kingAttacks, 64);
+    printTable("betweenBB[64][64]", &betweenBB[0][0], 64 * 64);
+    printTable("lineBB[64][64]", &lineBB[0][0], 64 * 64);
+
+    printf("namespace Zobrist {\n\n");
+    printTable("pieces[12][64]", &zobristPieces[0][0], 12 * 64);
+    printTable("castling[4]", zobristCastling, 4);
+    printTable("enPassant[8]", zobristEnPassant, 8);
+    printf("extern const U64 blackMove = 0x%016llxULL;\n\n", zobristBlackMove);
+    printf("}\n");
+    return 0;
+}